@@ -0,0 +1,61 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _fiber_h_
+#define _fiber_h_ 1
+
+#include "kostypes.h"
+
+#include <sys/types.h>
+
+// M:N user-level threads: fibers are multiplexed onto a fixed set of virtual
+// processors (VP), each served by exactly one kernel thread (carrier) at a
+// time.  Creation, yield, join, and fiber_sem P/V never enter the kernel
+// unless a VP runs out of work.  fiber_syscall hands the VP to a spare
+// carrier for the duration of a blocking call, so that the other fibers on
+// that VP keep running.  All fiber_* routines except fiber_run must be called
+// from within a fiber.  Fibers are always joinable and must be joined;
+// fibers still runnable when the first fiber finishes are abandoned.
+
+struct Fiber;
+typedef struct Fiber* fiber_t;
+
+typedef struct FiberSem {
+  volatile mword lock;
+  mword          count;
+  struct Fiber*  head;
+  struct Fiber*  tail;
+} fiber_sem_t;
+
+// run 'func(arg)' as the first fiber on 'vps' VPs; returns when it finishes
+extern "C" int fiber_run(int vps, void* (*func)(void*), void* arg, void** result);
+
+extern "C" int fiber_create(fiber_t* fid, void* (*func)(void*), void* arg);
+extern "C" int fiber_join(fiber_t fid, void** result);
+extern "C" void fiber_exit(void* result) __attribute__((noreturn));
+extern "C" void fiber_yield(void);
+extern "C" fiber_t fiber_self(void);
+extern "C" int fiber_vp(void);
+
+extern "C" int fiber_sem_init(fiber_sem_t* sem, mword init);
+extern "C" int fiber_sem_P(fiber_sem_t* sem);
+extern "C" int fiber_sem_V(fiber_sem_t* sem);
+
+// blocking system call with VP handoff (see SyscallNum in syscalls.h)
+extern "C" ssize_t fiber_syscall(mword x, mword a1 = 0, mword a2 = 0, mword a3 = 0, mword a4 = 0, mword a5 = 0);
+extern "C" int fiber_usleep(useconds_t usecs);
+
+#endif /* _fiber_h_ */
@@ -45,6 +45,7 @@ public:
 extern "C" {
 #endif
 
+static const int PTHREAD_BARRIER_SERIAL_THREAD = -1;
 static const mword PTHREAD_CANCEL_ASYNCHRONOUS = 0;
 static const mword PTHREAD_CANCEL_ENABLE = 0;
 static const mword PTHREAD_CANCEL_DEFERRED = 0;
@@ -70,28 +71,41 @@ static const mword PTHREAD_PROCESS_PRIVATE = 0;
 //static const mword PTHREAD_SCOPE_SYSTEM = 0;
 
 typedef mword pthread_attr_t;
-typedef mword pthread_barrier_t;
+typedef struct PthreadBarrier {            // futex on 'seq'
+  mword count;
+  mword arrived;
+  mword seq;
+  PthreadBarrier() : count(0), arrived(0), seq(0) {}
+} pthread_barrier_t;
 typedef mword pthread_barrierattr_t;
-typedef struct PthreadCond {
-  Benaphore ben;
-  PthreadCond() {}
+typedef struct PthreadCond {               // futex on 'seq'
+  mword seq;
+  mword waiters;
+  struct PthreadMutex* mutex;               // broadcast requeues onto mutex
+  PthreadCond() : seq(0), waiters(0), mutex(nullptr) {}
 } pthread_cond_t;
 typedef mword pthread_condattr_t;
 typedef mword pthread_key_t;
-typedef struct PthreadMutex {
-  Benaphore ben;
-  PthreadMutex() {}
+typedef struct PthreadMutex {              // 0 free, 1 locked, 2 contended
+  mword state;
+  PthreadMutex() : state(0) {}
 } pthread_mutex_t;
 typedef mword pthread_mutexattr_t;
 typedef mword pthread_once_t;
-typedef mword pthread_rwlock_t;
+typedef struct PthreadRWLock {            // futex on 'seq'
+  mword state;                              // writer bit | reader count
+  mword seq;                                // bumped by every waking unlock
+  mword waiters;                            // blocked readers and writers
+  mword writers;                            // queued writers hold off readers
+  PthreadRWLock() : state(0), seq(0), waiters(0), writers(0) {}
+} pthread_rwlock_t;
 typedef mword pthread_rwlockattr_t;
 typedef mword pthread_spinlock_t;
 typedef mword pthread_t;
 
 static const pthread_cond_t PTHREAD_COND_INITIALIZER;
 static const pthread_mutex_t PTHREAD_MUTEX_INITIALIZER;
-static const pthread_rwlock_t PTHREAD_RWLOCK_INITIALIZER = ~mword(0);
+static const pthread_rwlock_t PTHREAD_RWLOCK_INITIALIZER;
 
 int pthread_atfork(void (*)(void), void (*)(void), void(*)(void));
 int pthread_attr_destroy(pthread_attr_t *);
@@ -19,6 +19,11 @@ extern "C" pid_t getcid();
 
 extern "C" int privilege(void*, mword, mword, mword, mword);
 
+// block while *addr == expected (timeout: relative ns), wake up to n waiters
+extern "C" int futexWait(mword* addr, mword expected, mword timeout);
+extern "C" int futexWake(mword* addr, mword n);
+extern "C" int futexRequeue(mword* addr, mword n, mword* addr2, mword m, mword expected);
+
 namespace SyscallNum {
 
 enum : mword {
@@ -44,6 +49,11 @@ enum : mword {
   semV,
   privilege,
   _init_sig_handler,
+  fork,
+  futexWait,
+  futexWake,
+  futexRequeue,
+  _clock_gettime,
   max
 };
 
@@ -16,6 +16,18 @@
 ******************************************************************************/
 #include "kernel/AddressSpace.h"
 
+mword AddressSpace::asidCounter = 0;
+
+// ShootdownIPI: run pending invalidation for the current user AS now,
+// instead of at the next AS switch (interrupts disabled)
+void BaseAddressSpace::shootdownIPI() {
+  AddressSpaceMarker& marker = LocalProcessor::self()->userASM;
+  BaseAddressSpace* as = marker.as;
+  ScopedLock<> sl(as->ulock);
+  as->leave<true>(marker);
+  as->enter(marker);
+}
+
 void AddressSpace::print(ostream& os) const {
   static_assert(recptindex == ptentries / 2, "recptindex must be ptentries / 2");
   bool kernel = (this == &defaultAS);
@@ -20,6 +20,7 @@
 #include "kernel/FrameManager.h"
 #include "kernel/KernelHeap.h"
 #include "kernel/SystemProcessor.h"
+#include "kernel/VmArea.h"
 #include "machine/Paging.h"
 
 #include "extern/stl/mod_set"
@@ -30,14 +31,16 @@ class BaseAddressSpace : public Paging {
   BaseAddressSpace(const BaseAddressSpace&) = delete;            // no copy
   BaseAddressSpace& operator=(const BaseAddressSpace&) = delete; // no assignment
 
+protected:
+  // one descriptor per unmap call (range), not per page
   struct MemoryDescriptor : public IntrusiveList<MemoryDescriptor>::Link {
     vaddr  vma;
-    paddr  pma;
     size_t size;
-    bool   alloc;
-    mword  dummy; // sizeof(MemoryDescriptor) >= sizeof(UnmapDescriptor)
-    MemoryDescriptor(vaddr v, paddr p, size_t s, bool a)
-      : vma(v), pma(p), size(s), alloc(a) {}
+    FrameBatch fb;
+    bool   flush;                      // e.g., page tables freed: full flush
+    bool   keepVm;                     // range still mapped: no VM release
+    MemoryDescriptor(vaddr v, size_t s, const FrameBatch& f, bool fl, bool k)
+      : vma(v), size(s), fb(f), flush(fl), keepVm(k) {}
     MemoryDescriptor(const MemoryDescriptor&) = default;
     MemoryDescriptor& operator=(const MemoryDescriptor&) = default;
   };
@@ -53,7 +56,6 @@ class BaseAddressSpace : public Paging {
 
   static_assert(sizeof(MemoryDescriptor) >= sizeof(UnmapDescriptor), "type sizes");
 
-protected:
   SpinLock ulock;                      // lock protecting page invalidation data
   sword unmapEpoch;                             // unmap epoch counter
   IntrusiveList<MemoryDescriptor> memoryList;   // list of pages to unmap
@@ -63,10 +65,17 @@ protected:
 
   SpinLock vlock;                      // lock protecting virtual address range
   vaddr mapBottom, mapStart, mapTop;
+  bool globalPages;                    // full TLB flush must include G pages
+  bool sharedTables;                   // kernel: tables shared, never freed
+  mword tablesReclaimed;               // page tables freed at unmap
 
   enum MapCode { NoAlloc, Alloc, Guard, Lazy };
 
-  BaseAddressSpace() : unmapEpoch(0), mapBottom(0), mapStart(0), mapTop(0) {}
+  static const size_t flushThreshold = 32;   // pages: invlpg vs. full flush
+  static const size_t shootdownMin = 64;     // pages: IPI vs. lazy invalidation
+
+  BaseAddressSpace(bool g = false) : unmapEpoch(0), mapBottom(0), mapStart(0), mapTop(0),
+    globalPages(g), sharedTables(g), tablesReclaimed(0) {}
   virtual ~BaseAddressSpace() {
     KASSERT0(memoryList.empty());
     KASSERT0(markerList.empty());
@@ -78,7 +87,7 @@ protected:
   }
 
   static void verifyPT(paddr pt) {
-    KASSERTN( pt == CPU::readCR3(), FmtHex(pt), ' ', FmtHex(CPU::readCR3()));
+    KASSERTN( pt == currentPagetable(), FmtHex(pt), ' ', FmtHex(CPU::readCR3()));
   }
 
   static constexpr MapCode AllocCode(PageType owner) {
@@ -103,7 +112,8 @@ allocFailed:
     KABORT0();
   }
 
-  void putVmRange(MemoryDescriptor* md) {
+  // kernel: bump allocation, range returned once contiguous with mapStart
+  virtual void putVmRange(MemoryDescriptor* md) {
     UnmapDescriptor* ud = new (md) UnmapDescriptor(md->vma, md->vma + md->size);
     unmapSet.insert(ud);
     ScopedLock<> sl(vlock);
@@ -117,7 +127,7 @@ allocFailed:
       mapStart = ud->end;
       unmapSet.erase(iter);
       mdCache.deallocate(reinterpret_cast<MemoryDescriptor*>(ud));
-      // TODO: clear page tables in range [mapStart...ud->end]
+      // page tables in range already reclaimed at unmap -> postRange
     } while (!unmapSet.empty());
   }
 
@@ -147,14 +157,60 @@ allocFailed:
     KASSERT1( NoAlloc <= mc && mc <= Alloc, mc );
     KASSERT1( aligned(vma, pagesize<N>()), vma );
     KASSERT1( aligned(size, pagesize<N>()), size );
-    for (vaddr end = vma + size; vma < end; vma += pagesize<N>()) {
-      paddr pma = Paging::unmap<N,false>(vma); // TLB invalidated separately
-      bool alloc = (mc == Alloc && pma != guardPage && pma != lazyPage);
-      DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/post: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtHex(pma), " epoch:", unmapEpoch);
-      ScopedLock<> sl(ulock);
-      MemoryDescriptor* md = new (mdCache.allocate()) MemoryDescriptor(vma, pma, pagesize<N>(), alloc);
-      memoryList.push_back(*md);
-      unmapEpoch += 1;
+    FrameBatch fb;
+    for (vaddr addr = vma, end = vma + size; addr < end; addr += pagesize<N>()) {
+      paddr pma = Paging::unmap<N,false>(addr); // TLB invalidated separately
+      if (mc == Alloc && pma != guardPage && pma != lazyPage && pma != zeroPage) fb.add(pma, pagesize<N>());
+    }
+    postRange(vma, size, fb);
+  }
+
+  // region with mixed page sizes (transparent huge pages): unmap by entry
+  void unmapMixed( vaddr vma, size_t size ) {
+    FrameBatch fb;
+    for (vaddr addr = vma, end = vma + size; addr < end; ) {
+      size_t ps;
+      paddr pma = Paging::unmapLeaf(addr, end, ps, CurrFM()); // TLB invalidated separately
+      if (pma != guardPage && pma != lazyPage && pma != zeroPage) fb.add(pma, ps);
+      addr += ps;
+    }
+    postRange(vma, size, fb);
+  }
+
+  // Page tables that became empty are freed along with the data frames.
+  // vlock excludes concurrent mmap into free VM covered by the same table;
+  // page faults only touch tables with lazy entries, which are not empty.
+  // Stale paging-structure caches and TLB entries of the recursive mapping
+  // are removed by a full TLB flush before the table frames are released.
+  void postRange( vaddr vma, size_t size, FrameBatch& fb ) {
+    size_t tables = 0;
+    if (!sharedTables) {
+      ScopedLock<> sl(vlock);
+      tables = Paging::reclaim(vma, vma + size, fb);
+      tablesReclaimed += tables;
+    }
+    DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/post: ", FmtHex(vma), '/', FmtHex(size), " frames:", fb.count, " tables:", tables, " epoch:", unmapEpoch);
+    postInvalidation(vma, size, fb, tables > 0, false);
+  }
+
+  void postInvalidation( vaddr vma, size_t size, const FrameBatch& fb, bool flush, bool keepVm ) {
+    ScopedLock<> sl(ulock);
+    MemoryDescriptor* md = new (mdCache.allocate()) MemoryDescriptor(vma, size, fb, flush, keepVm);
+    memoryList.push_back(*md);
+    unmapEpoch += 1;
+  }
+
+  // active shootdown: IPI other processors currently in this AS, so that
+  // frames are released promptly; otherwise invalidated at next AS switch
+  void shootdown(size_t size) {
+#if TESTING_NEVER_SHOOTDOWN
+    return;
+#endif
+    if (size < shootdownMin * smallps) return;
+    ScopedLock<> sl(ulock);
+    SystemProcessor* self = LocalProcessor::self();
+    for (AddressSpaceMarker* m = markerList.front(); m != markerList.fence(); m = markerList.next(*m)) {
+      if (m->proc != self) m->proc->sendShootdownIPI();
     }
   }
 
@@ -167,21 +223,25 @@ allocFailed:
     return addr;
   }
 
+  // top 'commit' bytes allocated, rest lazy (kernel) or AllocCode (user)
   template<PageType owner>
-  vaddr ballocStack(size_t ss) {
+  vaddr ballocStack(size_t ss, size_t commit) {
     KASSERT1(ss >= minimumStack, ss);
+    KASSERTN(commit <= ss && aligned(commit, pagesize<stackpl>()), ss, ' ', commit);
     size_t size = ss + stackGuardPage;
     ScopedLock<> sl(vlock);
     vaddr vma = getVmRange<stackpl>(0, size);
     KASSERTN(size == ss + stackGuardPage, ss, ' ', size);
     mapRegion<stackpl,Guard,owner>(0, vma, stackGuardPage, Data);
     vma += stackGuardPage;
-    mapRegion<stackpl,AllocCode(owner),owner>(0, vma, ss, Data);
+    if (commit < ss) mapRegion<stackpl,Lazy,owner>(0, vma, ss - commit, Data);
+    mapRegion<stackpl,AllocCode(owner),owner>(0, vma + ss - commit, commit, Data);
     return vma;
   }
 
   void enter(AddressSpaceMarker& marker) {
     marker.enterEpoch = unmapEpoch;
+    marker.as = this;
     markerList.push_back(marker);
   }
 
@@ -194,12 +254,17 @@ allocFailed:
     // explicit TLB invalidation of TLB entries for pages removed since
     // 'enterEpoch'.  Invalidation iterates backwards -> easier!
     // In kernelSpace, pages are G(lobal), so TLBs not flushed at 'mov cr3'.
+    // Large ranges: full flush (incl. G pages for kernel) ends the walk.
     if (invalidate) {
       MemoryDescriptor* md = memoryList.back();
       for (sword e = unmapEpoch; e - marker.enterEpoch > 0; e -= 1) {
         KASSERT0(md != memoryList.fence());
-        DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/kinv: ", FmtHex(md->vma), '/', FmtHex(md->size), " -> ", FmtHex(md->pma), " epoch:", e-1);
-        CPU::InvTLB(md->vma);
+        DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/kinv: ", FmtHex(md->vma), '/', FmtHex(md->size), " epoch:", e-1);
+        if (md->flush || md->size > flushThreshold * smallps) {
+          CPU::FlushTLB(globalPages);
+          break;
+        }
+        for (vaddr v = md->vma; v < md->vma + md->size; v += smallps) CPU::InvTLB(v);
         md = IntrusiveList<MemoryDescriptor>::prev(*md);
       }
     }
@@ -211,10 +276,11 @@ allocFailed:
       for (sword e = marker.enterEpoch; end - e > 0; e += 1) {
         KASSERT0(!memoryList.empty());
         MemoryDescriptor* md = memoryList.front();
-        DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/inv: ", FmtHex(md->vma), '/', FmtHex(md->size), " -> ", FmtHex(md->pma), (md->alloc ? "a" : ""), " epoch:", e);
-        if (md->alloc) CurrFM().release(md->pma, md->size);
+        DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/inv: ", FmtHex(md->vma), '/', FmtHex(md->size), " frames:", md->fb.count, " epoch:", e);
+        md->fb.release(CurrFM());
         IntrusiveList<MemoryDescriptor>::remove(*md);
-        putVmRange(md);
+        if (md->keepVm) mdCache.deallocate(md);
+        else putVmRange(md);
       }
     }
   }
@@ -244,20 +310,79 @@ public:
     unmapRegion<stackpl,Alloc>(vma - stackGuardPage, ss + stackGuardPage);
   }
 
+  mword getTablesReclaimed() const { return tablesReclaimed; }
+
   static bool tablefault(vaddr vma, uint64_t pff) {
     return Paging::mapTable<pagetablepl>(vma, pff, CurrFM());
   }
+
+  static void shootdownIPI();
 };
 
 class KernelAddressSpace : public BaseAddressSpace {
+  bool lazyStacks;         // page fault stack installed on all processors
+
+  bool inRange(vaddr vma) const { return mapBottom <= vma && vma < mapTop; }
+
 public:
+  KernelAddressSpace() : BaseAddressSpace(true), lazyStacks(false) {}
+
   template<size_t N, bool alloc=true>
   vaddr mmap(vaddr addr, size_t size, paddr pma = topaddr) {
     return BaseAddressSpace::bmap<N,alloc,Kernel>(addr, size, pma);
   }
 
   vaddr allocStack(size_t ss) {
-    return BaseAddressSpace::ballocStack<Kernel>(ss);
+    return BaseAddressSpace::ballocStack<Kernel>(ss, ss);
+  }
+
+  // thread stacks: only top committed, grown from page fault handler; lazy
+  // part bounded by 'lazyStack', so that one thread cannot drain the reserve
+  vaddr allocLazyStack(size_t ss) {
+#if TESTING_NEVER_ALLOC_LAZY
+    return allocStack(ss);
+#else
+    size_t commit = ss > committedStack + lazyStack ? ss - lazyStack : committedStack;
+    return BaseAddressSpace::ballocStack<Kernel>(ss, lazyStacks ? commit : ss);
+#endif
+  }
+
+  void enableLazyStacks(_friend<Machine>) { lazyStacks = true; }
+
+  // lazy kernel stack page -> frame from per-CPU reserve; runs on the page
+  // fault stack: must not fault, print, or block (cf. Machine.cc)
+  bool stackfault(vaddr vma) {
+    if (!inRange(vma) || Paging::test(vma, Lazy) != pagesize<stackpl>()) return false;
+    FrameReserve& fr = LocalProcessor::self()->stackFrames;
+    if slowpath(fr.count == 0) KABORT1("kernel stack frame reserve exhausted");
+    fr.count -= 1;
+    paddr pma = fr.frame[fr.count];
+    bool success = Paging::mapLazy(vma, pma, Data | Kernel);
+    KASSERT1(success, FmtHex(vma));
+    return true;
+  }
+
+  bool stackoverflow(vaddr vma) {
+    return inRange(vma) && Paging::test(vma, Guard) == pagesize<stackpl>();
+  }
+
+  // top up stack frame reserve; called after thread switch
+  void refillStackReserve() {
+    FrameReserve& fr = LocalProcessor::self()->stackFrames;
+    while slowpath(fr.count < FrameReserve::capacity) {
+      paddr pma = CurrFM().allocFrame<stackpl>(); // might grow stack itself
+      fr.frame[fr.count] = pma;
+      fr.count += 1;
+    }
+  }
+
+  // committed part of stack: high-water mark, since never decommitted
+  size_t stackCommitted(vaddr vma, size_t ss) {
+    size_t size = 0;
+    for (vaddr v = vma; v < vma + ss; v += pagesize<stackpl>()) {
+      if (Paging::test(v, Mapped)) size += pagesize<stackpl>();
+    }
+    return size;
   }
 
   // allocate and map contiguous physical memory: device buffers -> set MMapIO?
@@ -280,14 +405,41 @@ extern KernelAddressSpace kernelAS;
 
 class AddressSpace : public BaseAddressSpace {
   paddr pagetable;         // root page table *physical* address
+  mword asid;              // unique, never reused -> PCID assignment
+
+  static mword asidCounter;
+  static mword newASID() { return __atomic_add_fetch(&asidCounter, 1, __ATOMIC_RELAXED); }
+
+  VmAreaSet vmAreas;       // mmap/stack regions in [mapBottom,mapTop)
+
+  static const mword stackCacheSize = 8;
+  vaddr stackCache[stackCacheSize];   // released default user stacks, mapped
+  mword stackCount;
+
+  static constexpr VmArea::State AreaState(MapCode mc) {
+    return mc == Lazy ? VmArea::Lazy : mc == Alloc ? VmArea::Alloc : mc == Guard ? VmArea::Guard : VmArea::Direct;
+  }
+
+  // unmapped range reusable: turn released area into hole
+  virtual void putVmRange(MemoryDescriptor* md) {
+    ScopedLock<> sl(vlock);
+    vmAreas.reclaim(md->vma, md->vma + md->size);
+    mdCache.deallocate(md);
+  }
+
+  bool releaseVm(vaddr addr, size_t size) {
+    ScopedLock<> sl(vlock);
+    if (!vmAreas.contains(addr)) return true;  // outside mmap range: ELF
+    return vmAreas.release(addr, addr + size);
+  }
 
 public:
-  AddressSpace(int) : pagetable(topaddr) {}
-  AddressSpace() {
+  AddressSpace(int) : pagetable(topaddr), asid(newASID()), stackCount(0) {}
+  AddressSpace() : asid(newASID()), stackCount(0) {
     pagetable = CurrFM().allocFrame<pagetablepl>();
     Paging::clone(pagetable);
     DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/cloned: ", FmtHex(pagetable));
-    BaseAddressSpace::setup(usertop - kernelps, usertop);
+    setup(usertop - kernelps);
   }
 
   void init(paddr p, _friend<Machine>) {
@@ -298,12 +450,14 @@ public:
 
   void setup(vaddr bssEnd) {
     BaseAddressSpace::setup(bssEnd, usertop);
+    vmAreas.init(mapBottom, mapTop);
+    stackCount = 0;
   }
 
   ~AddressSpace() {
     KASSERT0(pagetable != topaddr);
     DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/destroy:", FmtHex(pagetable));
-    KASSERT1(pagetable != CPU::readCR3(), FmtHex(CPU::readCR3()));
+    KASSERT1(pagetable != currentPagetable(), FmtHex(CPU::readCR3()));
     CurrFM().release(pagetable, pagetableps);
   }
 
@@ -313,31 +467,147 @@ public:
     Paging::clear(align_down(userbot, pagesize<pagelevels>()), align_up(usertop, pagesize<pagelevels>()), CurrFM());
   }
 
+  // 'addr' is a hint: used if free, otherwise best fit; topaddr if exhausted
   template<size_t N, bool alloc=true>
   vaddr mmap(vaddr addr, size_t size, paddr pma = topaddr) {
     verifyPT(pagetable);
-    return BaseAddressSpace::bmap<N,alloc,User>(addr, size, pma);
+    const MapCode mc = alloc ? AllocCode(User) : NoAlloc;
+    size = align_up(size, pagesize<N>());
+    ScopedLock<> sl(vlock);
+    addr = vmAreas.alloc(addr, size, pagesize<N>(), AreaState(mc), Data);
+    if (addr != topaddr) mapRegion<N,mc,User>(pma, addr, size, Data);
+    return addr;
   }
 
   template<size_t N, bool alloc=true>
   void munmap(vaddr addr, size_t size) {
     verifyPT(pagetable);
+    size = align_up(size, pagesize<N>());
+    bool valid = releaseVm(addr, size);
+    KASSERTN(valid, FmtHex(addr), '/', FmtHex(size));
     BaseAddressSpace::munmap<N,alloc>(addr, size);
+    shootdown(size);
+  }
+
+  // any page sizes, including partial unmap of larger pages
+  bool munmapMixed(vaddr addr, size_t size) {
+    verifyPT(pagetable);
+    if (!aligned(addr, smallps)) return false;
+    size = align_up(size, smallps);
+    if (!releaseVm(addr, size)) return false;
+    BaseAddressSpace::unmapMixed(addr, size);
+    shootdown(size);
+    return true;
   }
 
   vaddr allocStack(size_t ss) {
     verifyPT(pagetable);
-    return BaseAddressSpace::ballocStack<User>(ss);
+    KASSERT1(ss >= minimumStack, ss);
+    const MapCode mc = AllocCode(User);
+    size_t size = ss + stackGuardPage;
+    ScopedLock<> sl(vlock);
+    if (ss == defaultUserStack && stackCount > 0) return stackCache[--stackCount];
+    vaddr vma = vmAreas.alloc(0, size, pagesize<stackpl>(), AreaState(mc), Data, stackGuardPage);
+    KASSERT1(vma != topaddr, ss);
+    mapRegion<stackpl,Guard,User>(0, vma, stackGuardPage, Data);
+    vma += stackGuardPage;
+    mapRegion<stackpl,mc,User>(0, vma, ss, Data);
+    return vma;
   }
 
+  // default-size stacks are cached without unmapping: thread churn
   void releaseStack(vaddr vma, size_t ss) {
     verifyPT(pagetable);
+    if (ss == defaultUserStack) {
+      ScopedLock<> sl(vlock);
+      if (stackCount < stackCacheSize) {
+        stackCache[stackCount++] = vma;
+        return;
+      }
+    }
+    bool valid = releaseVm(vma - stackGuardPage, ss + stackGuardPage);
+    KASSERTN(valid, FmtHex(vma), '/', FmtHex(ss));
     BaseAddressSpace::releaseStack(vma, ss);
   }
 
+  // page-table frames currently used in user half
+  size_t getTableCount() {
+    verifyPT(pagetable);
+    ScopedLock<> sl(vlock);
+    return Paging::countTables(align_down(userbot, pagesize<pagelevels>()), align_up(usertop, pagesize<pagelevels>()));
+  }
+
+  // Synchronous invalidation for mappings that change, but stay valid
+  // (fork: whole user half becomes copy-on-write): other processors in
+  // this AS are interrupted and must pass the current epoch.  Waiters process their own pending entries, so
+  // that concurrent waiters (interrupts disabled) cannot deadlock.
+  void syncInvalidation() {
+    LocalProcessor::lock();
+    SystemProcessor* self = LocalProcessor::self();
+    AddressSpaceMarker& marker = self->userASM;
+    ulock.acquire();
+    sword target = unmapEpoch;
+    leave<true>(marker);
+    enter(marker);
+    for (AddressSpaceMarker* m = markerList.front(); m != markerList.fence(); m = markerList.next(*m)) {
+      if (m->proc != self) m->proc->sendShootdownIPI();
+    }
+    for (;;) {
+      bool done = true;
+      for (AddressSpaceMarker* m = markerList.front(); m != markerList.fence(); m = markerList.next(*m)) {
+        if (m->enterEpoch - target < 0) done = false;
+      }
+      if (done) break;
+      ulock.release();
+      CPU::Pause();
+      ulock.acquire();
+      leave<true>(marker);
+      enter(marker);
+    }
+    ulock.release();
+    LocalProcessor::unlock();
+  }
+
+  // copy-on-write duplicate of this (current) address space
+  void fork(AddressSpace& child) {
+    verifyPT(pagetable);
+    {
+      ScopedLock<> sl(vlock);
+      child.mapBottom = mapBottom;
+      child.mapStart = mapStart;
+      child.mapTop = mapTop;
+      child.vmAreas.copy(vmAreas);
+      child.stackCount = stackCount;   // copy-on-write like other stacks
+      for (mword i = 0; i < stackCount; i += 1) child.stackCache[i] = stackCache[i];
+      Paging::forkUser(child.pagetable, CurrFM());
+    }
+    postInvalidation(mapBottom, 0, FrameBatch(), true, true); // now read-only
+    syncInvalidation();
+  }
+
+  // faults in mmap range must hit a lazy area; type from area
   bool pagefault(vaddr vma, uint64_t pff) {
     verifyPT(pagetable);
-    return Paging::mapFromLazy(vma, Data | User, pff, CurrFM());
+    if ((pff & PageFaultFlags::WR()) && Paging::testCOW(vma)) {
+      paddr old = Paging::breakCOW(vma, CurrFM());
+      if (old != topaddr) {            // local TLB already invalidated
+        // stale read-only translations elsewhere only read the old frame,
+        // which is kept until the epoch is passed; writes fault spuriously
+        FrameBatch fb;
+        if (old != zeroPage) fb.add(old, smallps);
+        postInvalidation(align_down(vma, smallps), smallps, fb, false, true);
+        shootdown(smallps);
+      }
+      return true;
+    }
+    PageType type = Data;
+    if (vmAreas.contains(vma)) {
+      ScopedLock<> sl(vlock);
+      VmArea* a = vmAreas.find(vma);
+      if (!a || a->state != VmArea::Lazy) return false;
+      type = a->type;
+    }
+    return Paging::mapFromLazy(vma, type | User, pff, CurrFM());
   }
 
   // allocate memory and map to specific virtual address: ELF loading
@@ -354,12 +624,42 @@ public:
     mapRegion<N,NoAlloc,User>(pma, vma, size, t);
   }
 
+  // map frames shared by all instances of a binary: writable pages become
+  // copy-on-write; each mapping holds a frame reference -> never released
+  void mapShared( paddr pma, vaddr vma, size_t size, PageType t ) {
+    KASSERT1(vma < mapBottom || vma > mapTop, vma);
+    KASSERT1(aligned(vma, smallps) && aligned(pma, smallps) && aligned(size, smallps), FmtHex(vma));
+    uint64_t type = sharedType(t | User);
+    for (vaddr end = vma + size; vma < end; vma += smallps, pma += smallps) {
+      DBG::outl(DBG::VM, "AS(", FmtHex(this), ")/share: ", FmtHex(vma), " -> ", FmtHex(pma), " flags:", Paging::PageEntryFmt(type));
+      CurrFM().share(pma);
+      Paging::mapPage<smallpl>(vma, pma, type);
+    }
+  }
+
   void switchTo(AddressSpace& nextAS) {
     KASSERT0(LocalProcessor::checkLock());
     KASSERT0(pagetable != topaddr);
     verifyPT(pagetable);
     AddressSpaceMarker& marker = LocalProcessor::self()->userASM;
-    if (pagetable != nextAS.pagetable) {
+    if (pagetable != nextAS.pagetable && CPUID::pcidEnabled()) {
+      // TLB entries stay tagged with old PCID: remember last sync epoch;
+      // flush on return, if anything was unmapped in between
+      PcidCache& pc = LocalProcessor::self()->pcids;
+      pc.leave(marker.enterEpoch);
+      bool flush;
+      sword epoch = __atomic_load_n(&nextAS.unmapEpoch, __ATOMIC_RELAXED);
+      mword pcid = pc.enter(nextAS.asid, epoch, flush);
+      DBG::outl(DBG::AddressSpace, "AS(", FmtHex(pagetable), ")/switchTo: ", FmtHex(nextAS.pagetable), " pcid:", pcid, flush ? " flush" : "");
+      Paging::installPagetable(nextAS.pagetable, pcid, flush);
+      ulock.acquire();
+      leave<false>(marker);
+      ulock.release();
+      ScopedLock<> sl(nextAS.ulock);
+      nextAS.enter(marker);
+      // unmap before marker was listed: shootdown has missed this core
+      if slowpath(!flush && marker.enterEpoch != epoch) Paging::installPagetable(nextAS.pagetable, pcid, true);
+    } else if (pagetable != nextAS.pagetable) {
       DBG::outl(DBG::AddressSpace, "AS(", FmtHex(pagetable), ")/switchTo: ", FmtHex(nextAS.pagetable));
       Paging::installPagetable(nextAS.pagetable);
       ulock.acquire();
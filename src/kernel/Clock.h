@@ -19,15 +19,36 @@
 
 #include "machine/CPU.h"
 
+// tick: PIT counter (ms), used for coarse waiting and timer wheel deadlines
+// nanos: calibrated TSC (assumes invariant TSC, synchronized across cores)
 class Clock : public NoObject {
   static volatile mword tick;
+  static mword tscBase;                // TSC at calibration
+  static mword tickBase;               // tick at calibration
+  static mword nsMult;                 // ns per TSC cycle, 32.32 fixed point
 public:
+  static const mword nsPerTick = 1000000;
   static void ticker() { tick += 1; }
   static mword now() { return tick; }
   static void wait(mword ticks) {
     mword start = tick;
     while (tick < start + ticks) CPU::Pause();
   }
+  static void calibrate(mword tsc, mword ticks) {
+    nsMult = ((ticks * nsPerTick) << 32) / tsc;
+    tscBase = CPU::readTSC();
+    tickBase = tick;
+  }
+  static mword nanos() {
+    return ((__uint128_t)(CPU::readTSC() - tscBase) * nsMult) >> 32;
+  }
+  static void spinNanos(mword deadline) {
+    while (nanos() < deadline) CPU::Pause();
+  }
+  // tick that expires at or before 'deadline' (ns) -> spin the remainder
+  static mword nanosToTick(mword deadline) {
+    return tickBase + deadline / nsPerTick;
+  }
 };
 
 #endif /* _Clock_h_ */
@@ -0,0 +1,52 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/ElfImage.h"
+#include "extern/elfio/elf_types.hpp"
+
+using namespace ELFIO;
+
+ElfImage::ElfImage(const RamFile& rf) : count(0), entry(0), brk(0), loads(0), instances(0) {
+  KASSERT1(rf.size >= sizeof(Elf64_Ehdr), rf.size);
+  const Elf64_Ehdr* eh = (const Elf64_Ehdr*)rf.vma;
+  KASSERT0(eh->e_ident[EI_MAG0] == ELFMAG0 && eh->e_ident[EI_MAG1] == ELFMAG1
+    && eh->e_ident[EI_MAG2] == ELFMAG2 && eh->e_ident[EI_MAG3] == ELFMAG3);
+  KASSERT1(eh->e_ident[EI_CLASS] == ELFCLASS64, eh->e_ident[EI_CLASS]);
+  KASSERT1(eh->e_phentsize == sizeof(Elf64_Phdr), eh->e_phentsize);
+  KASSERTN(eh->e_phoff + eh->e_phnum * sizeof(Elf64_Phdr) <= rf.size, FmtHex(eh->e_phoff), ' ', eh->e_phnum);
+  entry = eh->e_entry;
+
+  const Elf64_Phdr* ph = (const Elf64_Phdr*)(rf.vma + eh->e_phoff);
+  for (mword i = 0; i < eh->e_phnum; i += 1) {
+    if (ph[i].p_type != PT_LOAD) continue;  // not a loadable segment
+    KASSERT1(count < maxSegments, count);
+    KASSERTN(ph[i].p_offset + ph[i].p_filesz <= rf.size, FmtHex(ph[i].p_offset), ' ', FmtHex(ph[i].p_filesz), ' ', FmtHex(rf.size));
+    KASSERTN(ph[i].p_memsz >= ph[i].p_filesz, FmtHex(ph[i].p_filesz), ' ', FmtHex(ph[i].p_memsz));
+    Segment& s = segments[count];
+    s.vma = ph[i].p_vaddr;
+    s.fend = s.vma + ph[i].p_filesz;
+    s.mend = s.vma + ph[i].p_memsz;
+    s.pma = rf.pma + ph[i].p_offset;
+    s.kma = rf.vma + ph[i].p_offset;
+    KASSERTN(s.vma - align_down(s.vma, smallps) == s.pma - align_down(s.pma, smallps), FmtHex(s.vma), ' ', FmtHex(s.pma));
+    // If .rodata and .text are in the same elf segment and small enough to
+    // fit into a single page, then .rodata ends up being marked executable.
+    s.type = (ph[i].p_flags & PF_W) ? Paging::Data :
+      (ph[i].p_flags & PF_X) ? Paging::Code : Paging::RoData;
+    if (s.mend > brk) brk = s.mend;
+    count += 1;
+  }
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _ElfImage_h_
+#define _ElfImage_h_ 1
+
+#include "kernel/KernelHeap.h"
+#include "machine/Paging.h"
+#include "world/Access.h"
+
+// Loadable segments of a boot-module binary: parsed once directly from the
+// module, cached with its RamFile and immutable afterwards.  All instances
+// map file content from the module frames (cf. AddressSpace::mapShared).
+class ElfImage {
+public:
+  struct Segment {
+    vaddr vma;                 // start of segment
+    vaddr fend;                // end of file content
+    vaddr mend;                // end of memory, including bss
+    paddr pma;                 // file content: module frames
+    vaddr kma;                 // file content: kernel mapping
+    Paging::PageType type;
+  };
+
+private:
+  static const mword maxSegments = 8;
+  Segment segments[maxSegments];
+  mword count;
+  vaddr entry;
+  vaddr brk;                   // end of highest segment
+  mword loads;                 // statistics
+  mword instances;
+
+public:
+  ElfImage(const RamFile& rf);
+
+  // cached image, parsed on first use
+  static ElfImage* get(RamFile& rf) {
+    ElfImage* img = __atomic_load_n(&rf.image, __ATOMIC_ACQUIRE);
+    if fastpath(img) return img;
+    ElfImage* ni = knew<ElfImage>(rf);
+    if (__atomic_compare_exchange_n(&rf.image, &img, ni, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return ni;
+    kdelete(ni);               // concurrent first use
+    return img;
+  }
+
+  mword size() const { return count; }
+  const Segment& segment(mword i) const { KASSERT1(i < count, i); return segments[i]; }
+  vaddr getEntry() const { return entry; }
+  vaddr getBreak() const { return brk; }
+
+  void attach() {
+    __atomic_add_fetch(&loads, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&instances, 1, __ATOMIC_RELAXED);
+  }
+  void detach() { __atomic_sub_fetch(&instances, 1, __ATOMIC_RELAXED); }
+  mword getLoads() const { return __atomic_load_n(&loads, __ATOMIC_RELAXED); }
+  mword getInstances() const { return __atomic_load_n(&instances, __ATOMIC_RELAXED); }
+};
+
+#endif /* _ElfImage_h_ */
@@ -14,14 +14,117 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
+#include "runtime/BlockingSync.h"
+#include "runtime/Scheduler.h"
+#include "runtime/Thread.h"
+#include "kernel/Clock.h"
 #include "kernel/FrameManager.h"
+#include "kernel/KernelHeap.h"
 #include "machine/Paging.h"
 
-void FrameZero(vaddr vma, paddr pma, size_t offset, size_t size, _friend<FrameManager> ff) {
+// interrupts disabled: window is per-CPU and must not be reused by preemption
+void FrameZero(mword slot, paddr pma, size_t offset, size_t size, _friend<FrameManager> ff, bool temporal) {
+  LocalProcessor::lock();
+  vaddr vma = zeroWindow(slot);
   Paging::mapPage<kernelpl>(vma, pma, Paging::Data, ff);
   DBG::outl(DBG::Frame, "FM/zero: ", FmtHex(pma + offset), '/', FmtHex(size));
-  memset((ptr_t)(vma + offset), 0, size);
+  if (temporal) memset((ptr_t)(vma + offset), 0, size);
+  else CPU::StreamZero(vma + offset, size);
   Paging::unmap<kernelpl>(vma, ff);
+  LocalProcessor::unlock();
+}
+
+FrameManager* FrameManager::nodes[maxNodes];
+mword FrameManager::nodeCount = 0;
+FrameManager::NodeRange FrameManager::ranges[maxNodeRanges];
+mword FrameManager::rangeCount = 0;
+uint32_t* FrameManager::shares = nullptr;
+
+void FrameManager::addNode( FrameManager& fm ) {
+  KASSERT1(nodeCount < maxNodes, nodeCount);
+  fm.node = nodeCount;
+  nodes[nodeCount] = &fm;
+  nodeCount += 1;
+}
+
+void FrameManager::addRange( paddr start, paddr end, mword node ) {
+  KASSERT1(node < nodeCount, node);
+  if (rangeCount == maxNodeRanges) {
+    DBG::outl(DBG::Frame, "FM: too many node ranges, ignoring ", FmtHex(start), '-', FmtHex(end));
+    return;
+  }
+  ranges[rangeCount] = { start, end, node };
+  rangeCount += 1;
+}
+
+// reference array covers all physical memory: allocated at first fork
+void FrameManager::share( paddr addr ) {
+  uint32_t* s = __atomic_load_n(&shares, __ATOMIC_ACQUIRE);
+  if slowpath(!s) {
+    size_t cnt = (baseAddress + memRange) / smallps;
+    uint32_t* ns = kmalloc<uint32_t>(cnt);
+    memset(ns, 0, cnt * sizeof(uint32_t));
+    if (__atomic_compare_exchange_n(&shares, &s, ns, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) s = ns;
+    else kfree<uint32_t>(ns, cnt);
+  }
+  KASSERT1(addr < baseAddress + memRange, FmtHex(addr));
+  __atomic_add_fetch(s + addr / smallps, 1, __ATOMIC_SEQ_CST);
+}
+
+void FrameManager::initCaches( mword cpus ) {
+#if TESTING_NEVER_FRAMECACHE
+  return;
+#endif
+  FrameCache* fc = knewN<FrameCache>(cpus);
+  for (mword i = 0; i < cpus; i += 1) {
+    fc[i].cleanCount = fc[i].dirtyCount = fc[i].largeCount = 0;
+  }
+  cacheCount = cpus;
+  __atomic_store_n(&caches, fc, __ATOMIC_RELEASE);
+}
+
+// return cached frames of all CPUs to the node's FrameMap
+bool FrameManager::drainNodeCaches() {
+  bool drained = false;
+  for (mword i = 0; i < cacheCount; i += 1) {
+    FrameCache& fc = caches[i];
+    ScopedLock<> sl(fc.lock);
+    if (fc.cleanCount + fc.dirtyCount + fc.largeCount == 0) continue;
+    for (size_t c = 0; c < fc.cleanCount; c += 1) fmap.FrameMap<smallpl>::releaseDirect(fc.clean[c]);
+    fmap.FrameMap<smallpl>::releaseBatch(fc.dirty, fc.dirtyCount);
+    for (size_t c = 0; c < fc.largeCount; c += 1) fmap.FrameMap<kernelpl>::releaseDirect(fc.large[c]);
+    fc.cleanCount = fc.dirtyCount = fc.largeCount = 0;
+    drained = true;
+  }
+  return drained;
+}
+
+// memory exhausted: frames might still be parked in other CPUs' caches
+bool FrameManager::drainCaches() {
+  bool drained = drainNodeCaches();
+  for (mword i = 1; i < nodeCount; i += 1) {
+    if (nodes[(node + i) % nodeCount]->drainNodeCaches()) drained = true;
+  }
+  return drained;
+}
+
+// keep 'zeroTarget' bytes of pre-zeroed frames; lowest priority, so only
+// runs when the node's processor has nothing else to do
+void FrameManager::zeroLoop(FrameManager* fm) {
+  for (;;) {
+    while (fm->getZeroed() < zeroTarget && fm->zeroMemory()) CurrThread()->yield();
+    Timeout::sleep(Clock::now() + zeroInterval);
+  }
+}
+
+void FrameManager::startZeroing( Scheduler& sched ) {
+#if TESTING_NEVER_ZERODAEMON
+  return;
+#endif
+  zeroing = true;
+  Thread* t = Thread::create()->setPriority(idlePriority)->setScheduler(sched)->setAffinity(true);
+  t->start((ptr_t)zeroLoop, (ptr_t)this);
+  DBG::outl(DBG::Boot, "FM/node ", node, ": zeroing thread ", FmtHex(t));
 }
 
 template<size_t PL>
@@ -20,12 +20,23 @@
 #include "kernel/Output.h"
 #include "machine/Processor.h"
 
-void FrameZero(vaddr vma, paddr pma, size_t offset, size_t size, _friend<FrameManager>);
+class Scheduler;
+
+// per-CPU zeroing windows: FrameMap zeroing and frame cache zeroing
+static inline vaddr zeroWindow(mword slot) {
+  return zeroBase + kernelps * (2 * LocalProcessor::getIndex() + slot);
+}
+
+// zero through per-CPU window 'slot'; non-temporal stores, unless the frame
+// is about to be used by the caller anyway
+void FrameZero(mword slot, paddr pma, size_t offset, size_t size, _friend<FrameManager>, bool temporal = false);
 
 template<size_t PL> class FrameMap : public FrameMap<PL+1> {
   SpinLock lock;
   HierarchicalBitmap<ptentries,framebits-pagesizebits<PL>()> frames;
   HierarchicalBitmap<ptentries,framebits-pagesizebits<PL>()> tozero;
+  size_t dirty;                             // frames in 'tozero'
+  size_t stalls;                            // inline zeroing during alloc
   static const size_t fsize = pagesize<PL>();
 
   bool releaseInternal(size_t idx) {
@@ -41,11 +52,11 @@ template<size_t PL> class FrameMap : public FrameMap<PL+1> {
     size_t idx = tozero.find();
     if (idx == limit<size_t>()) return false;
     tozero.clr(idx);
+    dirty -= 1;
     lock.release();
     paddr pma = idx * fsize;
     paddr apma = align_down(pma, kernelps);
-    vaddr vma = zeroBase + kernelps * LocalProcessor::getIndex();
-    FrameZero(vma, apma, pma - apma, fsize, ff);
+    FrameZero(0, apma, pma - apma, fsize, ff);
     lock.acquire();
     releaseInternal(idx);
     return true;
@@ -64,6 +75,7 @@ public:
     return releaseInternal(idx);
   }
 
+  // one lock acquisition per run of frames up to the next larger frame
   bool release(size_t idx, size_t cnt) {
     while (cnt > 0) {
       if ( aligned(idx, ptentries) && cnt >= ptentries
@@ -71,27 +83,58 @@ public:
         idx += align_down(cnt, ptentries);
         cnt -= align_down(cnt, ptentries);
       } else {
+        size_t run = min(cnt, align_up(idx + 1, ptentries) - idx);
         ScopedLock<> sl(lock);
-        tozero.set(idx);
-        idx += 1;
-        cnt -= 1;
+        for (size_t i = 0; i < run; i += 1) tozero.set(idx + i);
+        dirty += run;
+        idx += run;
+        cnt -= run;
       }
     }
     return true;
   }
 
+  void releaseBatch(const size_t* idx, size_t cnt) {
+    ScopedLock<> sl(lock);
+    for (size_t i = 0; i < cnt; i += 1) tozero.set(idx[i]);
+    dirty += cnt;
+  }
+
   bool zero(_friend<FrameManager> ff) {
     return zeroLocked(ff) || FrameMap<PL+1>::zero(ff);
   }
 
+  // unlocked snapshots for reporting
+  size_t dirtySize() const { return dirty * fsize + FrameMap<PL+1>::dirtySize(); }
+  size_t stallCount() const { return stalls + FrameMap<PL+1>::stallCount(); }
+
   size_t alloc(_friend<FrameManager> ff) {
     ScopedLock<> sl(lock);
+    return allocInternal(ff);
+  }
+
+  // returns number of frames allocated (less than 'cnt' if exhausted)
+  size_t allocBatch(size_t* idx, size_t cnt, _friend<FrameManager> ff) {
+    ScopedLock<> sl(lock);
+    for (size_t i = 0; i < cnt; i += 1) {
+      idx[i] = allocInternal(ff);
+      if (idx[i] == limit<size_t>()) return i;
+    }
+    return cnt;
+  }
+
+private:
+  size_t allocInternal(_friend<FrameManager> ff) {
     size_t idx;
     for (;;) {
       idx = frames.find();
       if (idx != limit<size_t>()) break;
-      if (!zeroInternal(ff)) {
-        idx = FrameMap<PL+1>::alloc(ff) * ptentries;
+      if (zeroInternal(ff)) {
+        stalls += 1;                        // allocating thread pays
+      } else {
+        idx = FrameMap<PL+1>::alloc(ff);
+        if (idx == limit<size_t>()) return idx;  // exhausted
+        idx *= ptentries;
         frames.blockset(idx);
         break;
       }
@@ -101,6 +144,7 @@ public:
     return idx;
   }
 
+public:
   size_t allocRegion(size_t cnt, size_t lim, size_t range) {
     ScopedLock<> sl(lock);
     size_t idx = 0;
@@ -127,6 +171,7 @@ public:
   }
 
   void init(size_t range, bufptr_t p) {
+    dirty = stalls = 0;
     frames.init(divup(range, fsize), p);
     p += frames.allocsize(divup(range, fsize));
     tozero.init(divup(range, fsize), p);
@@ -140,23 +185,175 @@ public:
   bool releaseDirect(size_t) { return false; }
   bool release(size_t, size_t) { return false; }
   bool zero(_friend<FrameManager>) { return false; }
-  size_t alloc(_friend<FrameManager>) { KABORT1("OUT OF MEMORY"); }
+  size_t dirtySize() const { return 0; }
+  size_t stallCount() const { return 0; }
+  size_t alloc(_friend<FrameManager>) { return limit<size_t>(); }
   size_t allocRegion(size_t, size_t, size_t) { KABORT1("IMPOSSIBLE REGION ALLOCATION"); }
   void print(ostream&, paddr, size_t) {}
   size_t allocsize(size_t) { return 0; }
   void init(size_t, bufptr_t) {}
 };
 
+// per-CPU frame cache: zeroed small and large frames from batched refill,
+// released small frames for local reuse; lock is uncontended, except when
+// exhausted memory drains all caches (cf. FrameManager::drainCaches)
+struct FrameCache {
+  static const size_t smallCap = 64;
+  static const size_t largeCap = 2;
+  SpinLock lock;
+  size_t clean[smallCap];
+  size_t dirty[smallCap];
+  size_t large[largeCap];
+  size_t cleanCount;
+  size_t dirtyCount;
+  size_t largeCount;
+};
+
+// one FrameManager per NUMA node; all cover the full physical address range,
+// but only receive frames from their own node's ranges (cf. Machine::initBSP)
 class FrameManager {
   friend ostream& operator<<(ostream&, const FrameManager&);
   FrameMap<smallpl> fmap;
   paddr baseAddress;
   size_t memRange;
+  FrameCache* caches;
+  mword cacheCount;
+  mword node;
+  mword freeFrames;                         // small frames, incl. cached
+  mword allocCount;                         // small frames, cumulative
+  mword releaseCount;                       // small frames, cumulative
+  bool zeroing;                             // background zeroing thread
+
+  struct NodeRange {
+    paddr start;
+    paddr end;
+    mword node;
+  };
+  static const mword maxNodes = 8;
+  static const mword maxNodeRanges = 16;
+  static FrameManager* nodes[maxNodes];
+  static mword nodeCount;
+  static NodeRange ranges[maxNodeRanges];
+  static mword rangeCount;
+
+  // extra references per small frame (copy-on-write), allocated on demand
+  static uint32_t* shares;
+
+  bool unshare( paddr addr ) {
+    uint32_t* s = __atomic_load_n(&shares, __ATOMIC_RELAXED);
+    if fastpath(!s) return false;
+    s += addr / smallps;
+    uint32_t c = __atomic_load_n(s, __ATOMIC_RELAXED);
+    while (c > 0) {
+      if (__atomic_compare_exchange_n(s, &c, c - 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return true;
+    }
+    return false;
+  }
+
+  static const size_t zeroTarget = 0x4000000;   // pre-zeroed pool watermark
+  static const mword zeroInterval = 10;         // ms, when pool is full
+  static void zeroLoop(FrameManager* fm);
+
+  FrameCache& localCache() { return caches[LocalProcessor::getIndex()]; }
+
+  // cache lock held
+  size_t allocSmall(FrameCache& fc) {
+    _friend<FrameManager> ff;
+    if (fc.cleanCount) return fc.clean[--fc.cleanCount];
+    if (fc.dirtyCount) {                    // reuse locally released frame
+      size_t idx = fc.dirty[--fc.dirtyCount];
+      paddr pma = baseAddress + idx * smallps;
+      paddr apma = align_down(pma, kernelps);
+      FrameZero(1, apma, pma - apma, smallps, ff, true);
+      return idx;
+    }
+    fc.cleanCount = fmap.FrameMap<smallpl>::allocBatch(fc.clean, FrameCache::smallCap / 2, ff);
+    if (fc.cleanCount == 0) return limit<size_t>();
+    return fc.clean[--fc.cleanCount];
+  }
+
+  size_t allocLarge(FrameCache& fc) {
+    if (fc.largeCount == 0) {
+      fc.largeCount = fmap.FrameMap<kernelpl>::allocBatch(fc.large, FrameCache::largeCap, _friend<FrameManager>());
+      if (fc.largeCount == 0) return limit<size_t>();
+    }
+    return fc.large[--fc.largeCount];
+  }
+
+  void releaseSmall(FrameCache& fc, size_t idx) {
+    if (fc.dirtyCount == FrameCache::smallCap) {
+      fc.dirtyCount = FrameCache::smallCap / 2;
+      fmap.releaseBatch(fc.dirty + fc.dirtyCount, FrameCache::smallCap / 2);
+    }
+    fc.dirty[fc.dirtyCount++] = idx;
+  }
+
+  template<size_t N>
+  size_t allocLocal() {
+    size_t idx;
+    if (caches && (N == smallpl || N == kernelpl)) {
+      LocalProcessor::lock();               // stay with this CPU's cache
+      FrameCache& fc = localCache();
+      fc.lock.acquire();
+      idx = (N == smallpl) ? allocSmall(fc) : allocLarge(fc);
+      fc.lock.release();
+      LocalProcessor::unlock();
+    } else {
+      idx = fmap.FrameMap<N>::alloc(_friend<FrameManager>());
+    }
+    if (idx != limit<size_t>()) {
+      __atomic_sub_fetch(&freeFrames, pagesize<N>() / smallps, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&allocCount, pagesize<N>() / smallps, __ATOMIC_RELAXED);
+    }
+    return idx;
+  }
+
+  void releaseLocal( paddr addr, size_t size ) {
+    if (caches && size == smallps) {
+      LocalProcessor::lock();
+      FrameCache& fc = localCache();
+      fc.lock.acquire();
+      releaseSmall(fc, (addr - baseAddress) / smallps);
+      fc.lock.release();
+      LocalProcessor::unlock();
+    } else {
+      fmap.release((addr - baseAddress) / smallps, size / smallps);
+    }
+    __atomic_add_fetch(&freeFrames, size / smallps, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&releaseCount, size / smallps, __ATOMIC_RELAXED);
+  }
+
+  // frames are always returned to the node they belong to
+  FrameManager& owner( paddr addr ) {
+    for (mword i = 0; i < rangeCount; i += 1) {
+      if (addr >= ranges[i].start && addr < ranges[i].end) return *nodes[ranges[i].node];
+    }
+    return nodeCount ? *nodes[0] : *this;
+  }
+
+  bool drainNodeCaches();
+
+  template<size_t N>
+  paddr tryAllocNodes() {
+    size_t idx = allocLocal<N>();
+    if fastpath(idx != limit<size_t>()) return baseAddress + idx * pagesize<N>();
+    for (mword i = 1; i < nodeCount; i += 1) {
+      FrameManager& fm = *nodes[(node + i) % nodeCount];
+      idx = fm.allocLocal<N>();
+      if (idx != limit<size_t>()) return fm.baseAddress + idx * pagesize<N>();
+    }
+    return topaddr;
+  }
 
 public:
   size_t preinit( paddr base, paddr top ) {
     baseAddress = base;
     memRange = top - base;
+    caches = nullptr;
+    cacheCount = 0;
+    node = 0;
+    freeFrames = allocCount = releaseCount = 0;
+    zeroing = false;
     return fmap.allocsize(memRange);
   }
 
@@ -164,27 +361,74 @@ public:
     fmap.init(memRange, p);
   }
 
+  void initCaches( mword cpus );
+  void startZeroing( Scheduler& sched );
+
+  static void addNode( FrameManager& fm );
+  static void addRange( paddr start, paddr end, mword node );
+  static mword getNodeCount() { return nodeCount; }
+  static FrameManager& getNode( mword n ) { return *nodes[n]; }
+
+  mword getNode() const { return node; }
+  size_t getFree() const { return freeFrames * smallps; }
+  size_t getAllocated() const { return allocCount * smallps; }
+  size_t getReleased() const { return releaseCount * smallps; }
+  size_t getDirty() const { return fmap.dirtySize(); }
+  size_t getZeroed() const { size_t d = getDirty(), f = getFree(); return f > d ? f - d : 0; }
+  size_t getStalls() const { return fmap.stallCount(); }
+
+  void share( paddr addr );
+
+  bool exclusive( paddr addr ) {
+    uint32_t* s = __atomic_load_n(&shares, __ATOMIC_RELAXED);
+    return !s || __atomic_load_n(s + addr / smallps, __ATOMIC_SEQ_CST) == 0;
+  }
+
   void release( paddr addr, size_t size ) {
     KASSERT1(aligned(addr, smallps), FmtHex(addr));
     KASSERT1(aligned(size, smallps), FmtHex(size));
-    fmap.release((addr - baseAddress) / smallps, size / smallps);
+    if (size == smallps && unshare(addr)) return;   // still referenced
+    FrameManager& fm = owner(addr);
+    KASSERT1(&fm == &owner(addr + size - 1), FmtHex(addr));
+    fm.releaseLocal(addr, size);
   }
 
   bool zeroMemory() { return fmap.zero(_friend<FrameManager>()); }
 
+  // idle loop only zeroes, if there is no background zeroing thread
+  bool zeroIdle() { return !zeroing && zeroMemory(); }
+
+  bool drainCaches();
+
+  // local node first, then remote nodes on exhaustion, then once more after
+  // draining all per-CPU caches; topaddr, if none
+  template<size_t N>
+  paddr tryAllocFrame() {
+    paddr pma = tryAllocNodes<N>();
+    if slowpath(pma == topaddr && drainCaches()) pma = tryAllocNodes<N>();
+    return pma;
+  }
+
   template<size_t N>
-  inline paddr allocFrame() {
-    return baseAddress + fmap.FrameMap<N>::alloc(_friend<FrameManager>()) * pagesize<N>();
+  paddr allocFrame() {
+    paddr pma = tryAllocFrame<N>();
+    if slowpath(pma == topaddr) KABORT1("OUT OF MEMORY");
+    return pma;
   }
 
+  // low memory (boot memory) is always on node 0 -> DMA regions from there
   paddr allocRegion( size_t& size, paddr align, paddr limitAddress ) {
+    if (nodeCount && this != nodes[0]) return nodes[0]->allocRegion(size, align, limitAddress);
     KASSERT1(align <= smallps, FmtHex(align));
     size = align_up(size, smallps);
     KASSERT1(size <= pagesize<smallpl+1>(), FmtHex(size));
     limitAddress -= size;
     size_t cnt = size / smallps;
     size_t lim = (limitAddress - baseAddress) / smallps;
-    return baseAddress + fmap.allocRegion(cnt, lim, memRange) * smallps;
+    paddr pma = baseAddress + fmap.allocRegion(cnt, lim, memRange) * smallps;
+    __atomic_sub_fetch(&freeFrames, cnt, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocCount, cnt, __ATOMIC_RELAXED);
+    return pma;
   }
 
   static FrameManager& curr() {
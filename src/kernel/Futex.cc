@@ -0,0 +1,143 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/Futex.h"
+
+#include <cerrno>
+
+Futex::Bucket Futex::table[pow2<mword>(Futex::bucketBits)];
+
+// waiter's bucket might change while unlocked (requeue)
+Futex::Bucket& Futex::lockBucket(Waiter& w) {
+  for (;;) {
+    Bucket* b = __atomic_load_n(&w.bucket, __ATOMIC_RELAXED);
+    b->lock.acquire();
+    if (b == w.bucket) return *b;
+    b->lock.release();
+  }
+}
+
+void Futex::lockPair(Bucket& b1, Bucket& b2) {
+  if (&b1 == &b2) {
+    b1.lock.acquire();
+  } else if (&b1 < &b2) {
+    b1.lock.acquire();
+    b2.lock.acquire();
+  } else {
+    b2.lock.acquire();
+    b1.lock.acquire();
+  }
+}
+
+void Futex::unlockPair(Bucket& b1, Bucket& b2) {
+  if (&b1 != &b2) b2.lock.release();
+  b1.lock.release();
+}
+
+// bucket lock held
+Futex::Waiter* Futex::unlink(Bucket& b, const void* space, vaddr addr) {
+  for (Waiter* w = b.waiters.front(); w != b.waiters.fence(); w = IntrusiveList<Waiter>::next(*w)) {
+    if (w->match(space, addr)) {
+      IntrusiveList<Waiter>::remove(*w);
+      return w;
+    }
+  }
+  return nullptr;
+}
+
+// bucket lock held, 'w' unlinked; bucket lock is kept until 'w' is either
+// claimed or known to be timed out, since the waiter leaves via lockBucket;
+// returns with bucket lock released, iff 'w' has been resumed
+bool Futex::resume(Waiter& w) {
+  Bucket& b = *w.bucket;
+  w.lock.acquire();
+  if (w.bq.resume(w.lock, [&b](Thread*) { b.lock.release(); })) return true;
+  w.lock.release();
+  return false;
+}
+
+int Futex::wait(const void* space, vaddr addr, mword expected, mword timeout) {
+  volatile mword* word = (volatile mword*)addr;
+  if (*word != expected) return -EAGAIN;      // page fault outside of locks
+  Bucket& b = bucket(space, addr);
+  Waiter w(space, addr, &b);
+  b.lock.acquire();
+  if (*word != expected) {
+    b.lock.release();
+    return -EAGAIN;
+  }
+  b.waiters.push_back(w);
+  w.lock.acquire();
+  b.lock.release();
+  if fastpath(w.bq.block(w.lock, timeout)) return 0;
+  Bucket& cb = lockBucket(w);                 // timed out or cancelled
+  if (w.onList()) IntrusiveList<Waiter>::remove(w);
+  cb.lock.release();
+  return timeout == limit<mword>() ? -EINTR : -ETIMEDOUT;
+}
+
+mword Futex::wake(const void* space, vaddr addr, mword n) {
+  Bucket& b = bucket(space, addr);
+  mword count = 0;
+  while (count < n) {
+    b.lock.acquire();
+    Waiter* w = unlink(b, space, addr);
+    if (!w) {
+      b.lock.release();
+      break;
+    }
+    if (resume(*w)) count += 1;
+    else b.lock.release();
+  }
+  return count;
+}
+
+// requeue all but the first 'n' matching waiters, then wake those; if none
+// could be woken, wake one on 'addr2' so that the requeued chain progresses
+int Futex::requeue(const void* space, vaddr addr, mword n, vaddr addr2, mword m, mword expected) {
+  volatile mword* word = (volatile mword*)addr;
+  if (*word != expected) return -EAGAIN;      // page fault outside of locks
+  Bucket& b1 = bucket(space, addr);
+  Bucket& b2 = bucket(space, addr2);
+  lockPair(b1, b2);
+  if (*word != expected) {
+    unlockPair(b1, b2);
+    return -EAGAIN;
+  }
+  mword skipped = 0;
+  mword moved = 0;
+  for (Waiter* w = b1.waiters.front(); w != b1.waiters.fence() && moved < m; ) {
+    Waiter* nw = IntrusiveList<Waiter>::next(*w);
+    if (w->match(space, addr)) {
+      if (skipped < n) {
+        skipped += 1;
+      } else {
+        w->addr = addr2;
+        if (&b1 != &b2) {
+          IntrusiveList<Waiter>::remove(*w);
+          b2.waiters.push_back(*w);
+          __atomic_store_n(&w->bucket, &b2, __ATOMIC_RELAXED);
+        }
+        moved += 1;
+      }
+    }
+    w = nw;
+  }
+  unlockPair(b1, b2);
+  mword woken = wake(space, addr, n);
+  if (woken == 0 && moved > 0) woken = wake(space, addr2, 1);
+  return woken + moved;
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _Futex_h_
+#define _Futex_h_ 1
+
+#include "generic/IntrusiveContainers.h"
+#include "runtime/BlockingSync.h"
+
+/* Futex: user-level blocking keyed by (address space, user address) in a
+ * global hashed table of wait lists; no kernel object per user lock and no
+ * per-process lock.  Each waiter blocks on its own queue under its own lock,
+ * so a waiter can be moved between buckets without touching the timeout
+ * path; the bucket lock only protects bucket membership. */
+class Futex : public NoObject {
+  struct Bucket;
+
+  struct Waiter : public IntrusiveList<Waiter>::Link {
+    const void* space;
+    vaddr addr;
+    Bucket* bucket;                     // changed under both bucket locks
+    BasicLock lock;                     // protects 'bq'
+    BlockingQueue bq;
+    Waiter(const void* s, vaddr a, Bucket* b) : space(s), addr(a), bucket(b) {}
+    bool match(const void* s, vaddr a) const { return space == s && addr == a; }
+  };
+
+  struct Bucket {
+    BasicLock lock;
+    IntrusiveList<Waiter> waiters;
+  };
+
+  static const mword bucketBits = 8;
+  static Bucket table[pow2<mword>(bucketBits)];
+
+  static Bucket& bucket(const void* space, vaddr addr) {
+    mword h = (mword(space) >> 6) ^ (addr >> 3);
+    h ^= h >> bucketBits;
+    h ^= h >> (2 * bucketBits);
+    return table[h % pow2<mword>(bucketBits)];
+  }
+
+  static Bucket& lockBucket(Waiter& w);
+  static void lockPair(Bucket& b1, Bucket& b2);
+  static void unlockPair(Bucket& b1, Bucket& b2);
+  static Waiter* unlink(Bucket& b, const void* space, vaddr addr);
+  static bool resume(Waiter& w);
+
+public:
+  // block, if *addr == expected; timeout in ticks (see BlockingQueue::block)
+  static int wait(const void* space, vaddr addr, mword expected, mword timeout = limit<mword>());
+  // resume up to 'n' waiters; returns number resumed
+  static mword wake(const void* space, vaddr addr, mword n);
+  // if *addr == expected: wake 'n' and move up to 'm' others to 'addr2'
+  static int requeue(const void* space, vaddr addr, mword n, vaddr addr2, mword m, mword expected);
+};
+
+#endif /* _Futex_h_ */
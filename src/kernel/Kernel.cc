@@ -17,6 +17,7 @@
 #include "runtime/Thread.h"
 #include "kernel/AddressSpace.h"
 #include "kernel/Clock.h"
+#include "kernel/LockProfile.h"
 #include "kernel/Output.h"
 #include "world/Access.h"
 #include "machine/Machine.h"
@@ -26,6 +27,9 @@
 KernelAddressSpace kernelAS;  // AddressSpace.h
 AddressSpace defaultAS(0);  // AddressSpace.h
 volatile mword Clock::tick; // Clock.h
+mword Clock::tscBase;       // Clock.h
+mword Clock::tickBase;      // Clock.h
+mword Clock::nsMult;        // Clock.h
 
 #if TESTING_KEYCODE_LOOP
 static void keybLoop() {
@@ -70,6 +74,10 @@ void kosMain() {
   extern Perf cpu_sample;
 	cpu_sample.start();
 	cpu_sample.print();
+#if TESTING_LOCK_PROFILE
+  Timeout::sleep(Clock::now() + 5000);
+  LockProfile::dump();
+#endif
 #if TESTING_PING_LOOP
 	for (;;) {
     Timeout::sleep(Clock::now() + 1000);
@@ -17,6 +17,7 @@
 #include "kernel/AddressSpace.h"
 #include "kernel/KernelHeap.h"
 #include "kernel/Output.h"
+#include "machine/Processor.h"
 
 #include "extern/dlmalloc/malloc_glue.h"
 #include "extern/dlmalloc/malloc.h"
@@ -80,3 +81,154 @@ void KernelHeap::legacy_free(ptr_t p) {
     kernelAS.munmap<kernelpl>(dud->addr, dud->len);
   }
 }
+
+// magazine: fixed-size stack of object pointers, exchanged with the depot
+struct Magazine {
+  static const mword capacity = 128 / sizeof(ptr_t) - 2; // header: next, rounds
+  Magazine* next;
+  mword rounds;
+  ptr_t obj[capacity];
+  bool empty() const { return rounds == 0; }
+  bool full() const { return rounds == capacity; }
+};
+static_assert(sizeof(Magazine) == 128, "Magazine size");
+
+// depot per size class; keeps a bounded number of full magazines
+struct Depot {
+  static const mword fullLimit = 16;
+  SpinLock lock;
+  Magazine* full;
+  Magazine* empty;
+  mword fullCount;
+};
+
+// per-CPU cache per size class; only accessed with interrupts disabled
+struct CpuCache {
+  Magazine* loaded;
+  Magazine* previous;
+  mword hits;
+  mword misses;
+};
+
+static Depot     depots[KernelHeap::classCount];
+static CpuCache* cpuCaches = nullptr;  // [cpus][classCount]
+static mword     cacheCpus = 0;
+
+static inline Magazine* pop(Magazine*& list) {
+  Magazine* m = list;
+  if (m) list = m->next;
+  return m;
+}
+
+static inline void push(Magazine*& list, Magazine* m) {
+  m->next = list;
+  list = m;
+}
+
+static Magazine* newMagazine(ptr_t mem) {
+  Magazine* m = (Magazine*)mem;
+  m->rounds = 0;
+  return m;
+}
+
+void KernelHeap::initCaches( mword cpus ) {
+#if TESTING_NEVER_MAGAZINES
+  return;
+#endif
+  CpuCache* cc = (CpuCache*)legacy_malloc(cpus * classCount * sizeof(CpuCache));
+  for (mword i = 0; i < cpus * classCount; i += 1) {
+    cc[i].loaded = newMagazine(legacy_malloc(sizeof(Magazine)));
+    cc[i].previous = newMagazine(legacy_malloc(sizeof(Magazine)));
+    cc[i].hits = cc[i].misses = 0;
+  }
+  cacheCpus = cpus;
+  __atomic_store_n(&cpuCaches, cc, __ATOMIC_RELEASE);
+}
+
+// invariant: 'previous' is always either full or empty
+// dlmalloc is only called outside of the per-CPU critical section, because
+// it might recursively allocate (e.g., during mmap/munmap)
+ptr_t KernelHeap::cacheAlloc(size_t c) {
+  if slowpath(!cpuCaches) return legacy_malloc(classSize(c));
+  LocalProcessor::lock();
+  CpuCache& cc = cpuCaches[LocalProcessor::getIndex() * classCount + c];
+  if slowpath(cc.loaded->empty()) {
+    if (cc.previous->full()) {
+      swap(cc.loaded, cc.previous);
+    } else {
+      Depot& d = depots[c];
+      d.lock.acquire();
+      Magazine* m = pop(d.full);
+      if (m) {
+        d.fullCount -= 1;
+        push(d.empty, cc.previous);
+      }
+      d.lock.release();
+      cc.misses += 1;
+      if (!m) {
+        LocalProcessor::unlock();
+        return legacy_malloc(classSize(c));
+      }
+      cc.previous = cc.loaded;
+      cc.loaded = m;
+    }
+  } else {
+    cc.hits += 1;
+  }
+  ptr_t p = cc.loaded->obj[--cc.loaded->rounds];
+  LocalProcessor::unlock();
+  return p;
+}
+
+void KernelHeap::cacheRelease(ptr_t p, size_t c) {
+  if slowpath(!cpuCaches) { legacy_free(p); return; }
+  Magazine* spare = nullptr;
+  Magazine* drain = nullptr;
+  for (;;) {
+    LocalProcessor::lock();
+    CpuCache& cc = cpuCaches[LocalProcessor::getIndex() * classCount + c];
+    if fastpath(!cc.loaded->full()) {
+      cc.hits += 1;
+    } else if (cc.previous->empty()) {
+      swap(cc.loaded, cc.previous);
+      cc.hits += 1;
+    } else {
+      Depot& d = depots[c];
+      d.lock.acquire();
+      Magazine* m = pop(d.empty);
+      if (!m) swap(m, spare);
+      if (!m) {                            // allocate empty magazine and retry
+        d.lock.release();
+        LocalProcessor::unlock();
+        spare = newMagazine(legacy_malloc(sizeof(Magazine)));
+        continue;
+      }
+      if (d.fullCount < Depot::fullLimit) {
+        push(d.full, cc.previous);
+        d.fullCount += 1;
+      } else {
+        drain = cc.previous;               // depot saturated -> back to dlmalloc
+      }
+      d.lock.release();
+      cc.previous = cc.loaded;
+      cc.loaded = m;
+      cc.misses += 1;
+    }
+    cc.loaded->obj[cc.loaded->rounds++] = p;
+    LocalProcessor::unlock();
+    break;
+  }
+  if (spare) legacy_free(spare);
+  if (drain) {
+    while (!drain->empty()) legacy_free(drain->obj[--drain->rounds]);
+    legacy_free(drain);
+  }
+}
+
+void KernelHeap::getStats( size_t c, mword& hits, mword& misses ) {
+  hits = misses = 0;
+  for (mword i = 0; i < cacheCpus; i += 1) {
+    hits += cpuCaches[i * classCount + c].hits;
+    misses += cpuCaches[i * classCount + c].misses;
+  }
+}
@@ -18,22 +18,46 @@
 #define _KernelHeap_h_ 1
 
 #include "generic/basics.h"
+#include "generic/bitmanip.h"
 
 extern "C" void free(void* p);
 extern "C" void* malloc(size_t);
 
-/* KernelHeap is where complex memory algorithms could be implemented */
+/* KernelHeap: sized allocations (alloc/release) go through per-CPU magazine
+ * caches per size class with a shared depot for refills (Bonwick/Adams);
+ * large objects and unsized malloc/free go directly to dlmalloc */
 class KernelHeap : public NoObject {
   friend void free(void*);
   friend void* malloc(size_t);
   static ptr_t legacy_malloc(size_t s);
   static void legacy_free(ptr_t p);
 
+public:
+  static const size_t minClassSize = 16;
+  static const size_t classCount = 8;   // 16 .. 2048 bytes
+  static const size_t maxClassSize = minClassSize << (classCount - 1);
+
+private:
+  static constexpr size_t sizeClass(size_t s) {
+    return s <= minClassSize ? 0 : ceilinglog2(s) - floorlog2(minClassSize);
+  }
+  static ptr_t cacheAlloc(size_t c);
+  static void cacheRelease(ptr_t p, size_t c);
+
 public:
   static void init0( vaddr p, size_t s );
   static void reinit( vaddr p, size_t s );
-  static vaddr alloc( size_t s ) { return (vaddr)legacy_malloc(s); }
-  static void release( vaddr p, size_t s ) { legacy_free((ptr_t)p); }
+  static void initCaches( mword cpus );
+  static vaddr alloc( size_t s ) {
+    if (s > maxClassSize) return (vaddr)legacy_malloc(s);
+    return (vaddr)cacheAlloc(sizeClass(s));
+  }
+  static void release( vaddr p, size_t s ) {
+    if (s > maxClassSize) legacy_free((ptr_t)p);
+    else if (p) cacheRelease((ptr_t)p, sizeClass(s));
+  }
+  static size_t classSize( size_t c ) { return minClassSize << c; }
+  static void getStats( size_t c, mword& hits, mword& misses );
 };
 
 template<typename T>
@@ -0,0 +1,63 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/LockProfile.h"
+
+#if TESTING_LOCK_PROFILE
+
+#include "kernel/Output.h"
+#include "kernel/SystemProcessor.h"
+#include "machine/Machine.h"
+
+#include <algorithm>
+
+static SpinLock dumpLock;
+
+// merge per-CPU tables (racy snapshot) and print most contended call sites
+void LockProfile::dump(mword top) {
+  static const mword siteCount = 1 << Context::lockSiteBits;
+  static LockSite merged[siteCount];
+  ScopedLock<> sl(dumpLock);
+  mword used = 0;
+  mword dropped = 0;
+  for (mword p = 0; p < Machine::getProcessorCount(); p += 1) {
+    const Context& c = Machine::getProcessor(p);
+    dropped += c.lockSiteDropped;
+    for (const LockSite& ls : c.lockSite) {
+      if (ls.site == 0) continue;
+      mword i = 0;
+      while (i < used && merged[i].site != ls.site) i += 1;
+      if (i == used) {
+        if (used == siteCount) { dropped += ls.count; continue; }
+        merged[used] = { ls.site, ls.lock, 0, 0, 0, 0 };
+        used += 1;
+      }
+      merged[i].count += ls.count;
+      merged[i].contended += ls.contended;
+      merged[i].wait += ls.wait;
+      merged[i].hold += ls.hold;
+    }
+  }
+  sort(merged, merged + used, [](const LockSite& a, const LockSite& b) { return a.wait > b.wait; });
+  DBG::outl(DBG::Perf, "lock profile: ", used, " sites, ", dropped, " samples dropped, top ", min(top, used), " by wait cycles");
+  for (mword i = 0; i < min(top, used); i += 1) {
+    const LockSite& ls = merged[i];
+    DBG::outl(DBG::Perf, "  ", FmtHex(ls.site), " lock ", FmtHex(ls.lock), " acq: ", ls.count, " contended: ", ls.contended,
+      " wait: ", ls.wait, " hold: ", ls.hold, " avg hold: ", ls.hold / max(ls.count, mword(1)));
+  }
+}
+
+#endif /* TESTING_LOCK_PROFILE */
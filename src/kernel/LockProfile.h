@@ -0,0 +1,54 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _LockProfile_h_
+#define _LockProfile_h_ 1
+
+#include "machine/CPU.h"
+#include "machine/Processor.h"
+
+#if TESTING_LOCK_PROFILE
+
+// lock contention statistics per call site in per-CPU tables; compiled out
+// by default; not inlined: return address identifies the code that took the
+// lock; the lock keeps the site for attributing its hold time at release
+class LockProfile : public NoObject {
+public:
+  static mword acquired(const void* lock, mword wait, bool contended) __ninline {
+    mword site = mword(__builtin_return_address(0));
+    LocalProcessor::lock();
+    LockSite* ls = LocalProcessor::getLockSite(site);
+    if (ls) {
+      ls->lock = mword(lock);
+      ls->count += 1;
+      if (contended) ls->contended += 1;
+      ls->wait += wait;
+    }
+    LocalProcessor::unlock();
+    return site;
+  }
+  static void released(mword site, mword hold) {
+    LocalProcessor::lock();
+    LockSite* ls = LocalProcessor::getLockSite(site);
+    if (ls) ls->hold += hold;
+    LocalProcessor::unlock();
+  }
+  static void dump(mword top = 16);
+};
+
+#endif /* TESTING_LOCK_PROFILE */
+
+#endif /* _LockProfile_h_ */
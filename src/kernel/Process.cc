@@ -16,9 +16,8 @@
 ******************************************************************************/
 #include "runtime/Thread.h"
 #include "kernel/Process.h"
-#include "extern/elfio/elfio.hpp"
 
-SpinLock Process::elfLock;
+mword Process::pidCounter = 0;
 
 void Process::invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) {
   UserThread* ut = Process::CurrUT();
@@ -29,65 +28,54 @@ void Process::invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) {
   unreachable();
 }
 
+// child returns from 'fork' syscall with 0, on copy of parent's user stack
+void Process::invokeFork(ptr_t rip, ptr_t usp, ptr_t rflags) {
+  UserThread* ut = Process::CurrUT();
+  DBG::outl(DBG::Threads, "UserThread fork: ", FmtHex(ut), '/', FmtHex(rip));
+  startForkedCode(vaddr(ut), vaddr(rip), vaddr(usp), mword(rflags));
+  unreachable();
+}
+
 void Process::loadAndRun(Process* p) {
   funcvoid2_t entry = p->load();
   DBG::outl(DBG::Process, "Process entry: ", FmtHex(ptr_t(entry)));
   invokeUser(entry, nullptr, nullptr);
 }
 
+// Code and read-only data are shared with the boot module.  Writable
+// pages are mapped copy-on-write; a page with both file content and bss
+// is copied, since the module holds unrelated bytes after the file part.
 inline funcvoid2_t Process::load() {
   KASSERT0(threadStore.size() == 1);
   auto iter = kernelFS.find(fileName);
   KASSERT1(iter != kernelFS.end(), fileName.c_str())
-  RamFile& rf = iter->second;
-  ScopedLock<> sl(elfLock);
-  ELFIO::elfio elfReader;
-  bool check = elfReader.load(fileName.c_str());
-  KASSERT0(check);
-  KASSERT1(elfReader.get_class() == ELFCLASS64, elfReader.get_class());
+  image = ElfImage::get(iter->second);
+  image->attach();
 
   DBG::outl(DBG::Process, "Process exec: ", FmtHex(this), ' ', fileName);
 
-  vaddr currBreak = 0;
-  for (int i = 0; i < elfReader.segments.size(); ++i) {
-    const ELFIO::segment* pseg = elfReader.segments[i];
-    if (pseg->get_type() != PT_LOAD) continue;  // not a loadable segment
-
-    KASSERTN(pseg->get_file_offset() + pseg->get_file_size() <= rf.size, FmtHex(pseg->get_file_offset()), ' ', FmtHex(pseg->get_file_size()), ' ', FmtHex(rf.size));
-    KASSERTN(pseg->get_memory_size() >= pseg->get_file_size(), FmtHex(pseg->get_file_size()), ' ', FmtHex(pseg->get_memory_size()));
-    paddr pma = rf.pma + pseg->get_file_offset();
-    paddr apma = align_down(pma, smallps);
-    vaddr vma = pseg->get_virtual_address();
-    vaddr avma = align_down(vma, smallps);
-    KASSERTN(vma - avma == pma - apma, FmtHex(vma), ' ', FmtHex(pma));
-    vaddr fend = vma + pseg->get_file_size();
-    vaddr afend = align_up(fend, smallps);
-    vaddr mend = vma + pseg->get_memory_size();
-    vaddr amend = align_up(mend, smallps);
-
-    // If .rodata and .text are in the same elf segment and small enough to
-    // fit into a single page, then .rodata ends up being marked executable.
-    PageType pageType = (pseg->get_flags() & PF_W) ? Data :
-      (pseg->get_flags() & PF_X) ? Code : RoData;
+  for (mword i = 0; i < image->size(); i += 1) {
+    const ElfImage::Segment& seg = image->segment(i);
+    vaddr avma = align_down(seg.vma, smallps);
+    paddr apma = align_down(seg.pma, smallps);
+    vaddr pend = seg.mend > seg.fend ? align_down(seg.fend, smallps) : align_up(seg.fend, smallps);
+    vaddr amend = align_up(seg.mend, smallps);
 
     DBG::outl(DBG::Process, "Process ",
-      pageType == Data ? "data" : pageType == Code ? "code" : "ro  ",
-      " segment: ", FmtHex(vma), '-', FmtHex(fend));
-    mapDirect<smallpl>(apma, avma, afend - avma, pageType);
-
-    if (mend > fend) {
-      DBG::outl(DBG::Process, "Process bss  segment: ", FmtHex(fend), '-', FmtHex(mend));
-      if (amend > afend) { // newly mapped memory is already wiped
-        allocDirect<smallpl>(afend, amend - afend, Data);
-      } else {             // leftover from binary: wipe to play it safe...
-        memset((ptr_t)fend, 0, mend - fend);
-      }
+      seg.type == Data ? "data" : seg.type == Code ? "code" : "ro  ",
+      " segment: ", FmtHex(seg.vma), '-', FmtHex(seg.fend));
+    if (pend > avma) mapShared(apma, avma, pend - avma, seg.type);
+
+    if (amend > pend) {
+      DBG::outl(DBG::Process, "Process bss  segment: ", FmtHex(seg.fend), '-', FmtHex(seg.mend));
+      allocDirect<smallpl>(pend, amend - pend, Data); // newly mapped memory is already wiped
+      vaddr copy = max(pend, seg.vma);
+      if (seg.fend > copy) memcpy((ptr_t)copy, (ptr_t)(seg.kma + (copy - seg.vma)), seg.fend - copy);
     }
-    if (mend > currBreak) currBreak = mend;
   }
 
-  setup(currBreak);
-  return (funcvoid2_t)elfReader.get_entry();
+  setup(image->getBreak());
+  return (funcvoid2_t)image->getEntry();
 }
 
 inline Process::UserThread* Process::setupThread(ptr_t invoke, ptr_t wrapper, ptr_t func, ptr_t data) {
@@ -104,6 +92,7 @@ inline Process::UserThread* Process::setupThread(ptr_t invoke, ptr_t wrapper, pt
 
 Process::~Process() {
   DBG::outl(DBG::Threads, "Process delete: ", FmtHex(this));
+  if (image) image->detach();
   for (size_t i = 0; i < ioHandles.currentIndex(); i += 1) {
     Access* a = ioHandles.access(i);
     if (a) kdelete(a);
@@ -119,6 +108,28 @@ void Process::exec(const string& fn) {
   ut->resume();
 }
 
+// Only the calling thread is duplicated; I/O handles are not inherited
+// (fresh standard streams).  The syscall frame (user rip, rflags, stack
+// pointer) is right below the thread object, cf. syscall_wrapper.S.
+mword Process::fork() {
+  UserThread* put = CurrUT();
+  mword* frame = (mword*)put;
+  Process* child = knew<Process>();
+  child->fileName = fileName;
+  child->sigHandler = sigHandler;
+  child->image = image;
+  if (image) image->attach();
+  AddressSpace::fork(*child);
+  put->ectx.save();
+  UserThread* ut = child->setupThread((ptr_t)invokeFork, ptr_t(frame[-3]), ptr_t(frame[-1]), ptr_t(frame[-2]));
+  ut->stackAddr = put->stackAddr;
+  ut->stackSize = put->stackSize;
+  ut->ectx = put->ectx;
+  DBG::outl(DBG::Process, "Process fork: ", FmtHex(this), " -> ", FmtHex(child));
+  ut->resume();
+  return child->getID();
+}
+
 // detach all -> cancel all
 void Process::exit() {
   UserThread* ut = CurrUT();
@@ -20,7 +20,9 @@
 #include "runtime/SynchronizedArray.h"
 #include "runtime/JoinableThread.h"
 #include "kernel/AddressSpace.h"
+#include "kernel/ElfImage.h"
 #include "kernel/KernelHeap.h"
+#include "kernel/StackPool.h"
 #include "world/Access.h"
 
 class Process : public AddressSpace {
@@ -32,7 +34,7 @@ class Process : public AddressSpace {
     CPU::ExtraContext ectx;  // fs/gs registers
     UserThread(vaddr ksb, size_t kss, Process& p) : JoinableThread(ksb, kss, p) {}
     static inline UserThread* create(Process& p, size_t kss = defaultStack) {
-      vaddr mem = kernelAS.allocStack(kss);
+      vaddr mem = StackPool::alloc(kss);
       vaddr This = mem + kss - sizeof(UserThread);
       DBG::outl(DBG::Threads, "UserThread create: ", FmtHex(mem), '/', FmtHex(kss), '/', FmtHex(This));
       return new (ptr_t(This)) UserThread(mem, kss, p);
@@ -44,11 +46,16 @@ class Process : public AddressSpace {
   size_t existingThreads;
   ManagedArray<UserThread*,KernelAllocator> threadStore;
 
-  static SpinLock elfLock;
   string fileName;
+  ElfImage* image;
   vaddr sigHandler;
+  mword pid;
+
+  static mword pidCounter;
+  static mword newPID() { return __atomic_add_fetch(&pidCounter, 1, __ATOMIC_RELAXED); }
 
   static void invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) __noreturn;
+  static void invokeFork(ptr_t rip, ptr_t usp, ptr_t rflags) __noreturn;
   static void loadAndRun(Process*);
   inline funcvoid2_t load();
   inline UserThread* setupThread(ptr_t invoke, ptr_t wrapper, ptr_t func, ptr_t data);
@@ -59,7 +66,7 @@ public:
   SpinLock semStoreLock;                                // used in syscalls.cc
 
   Process() : activeThreads(0), existingThreads(0),
-    threadStore(1), sigHandler(0), ioHandles(4) {
+    threadStore(1), image(nullptr), sigHandler(0), pid(newPID()), ioHandles(4) {
     ioHandles.store(knew<InputAccess>());
     ioHandles.store(knew<OutputAccess>(StdOut));
     ioHandles.store(knew<OutputAccess>(StdErr));
@@ -74,6 +81,7 @@ public:
   }
 
   void exec(const string& fn);
+  mword fork();
   void exit() __noreturn;
 
   void  setSignalHandler(vaddr sh) { sigHandler = sh; }
@@ -83,7 +91,7 @@ public:
   void  exitThread(ptr_t result) __noreturn;
   int   joinThread(mword idx, ptr_t& result);
 
-  mword getID() { return 0; }
+  mword getID() { return pid; }
   static mword getCurrentThreadID() { return CurrUT()->idx; }
 
   virtual void preThreadSwitch();
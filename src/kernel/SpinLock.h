@@ -17,11 +17,10 @@
 #ifndef _SpinLock_h_
 #define _SpinLock_h_ 1
 
+#include "kernel/LockProfile.h"
 #include "machine/CPU.h"
 #include "machine/Processor.h"
 
-/* TODO: add (exponential) backoff spin to spinlocks */
-
 class BinarySpinLock {
   volatile bool locked;
 public:
@@ -45,6 +44,82 @@ public:
   }
 } __caligned;
 
+// test-and-test-and-set with exponential backoff after failed attempt
+class BackoffSpinLock {
+  volatile bool locked;
+  static const mword minBackoff = 4;
+  static const mword maxBackoff = 1024;
+public:
+  BackoffSpinLock() : locked(false) {}
+  bool check() const { return locked; }
+  bool tryAcquire() {
+    KASSERT0(!CPU::interruptsEnabled());
+    return !__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE);
+  }
+  void acquire() {
+    KASSERT0(!CPU::interruptsEnabled());
+    mword backoff = minBackoff;
+    for (;;) {
+      if fastpath(!__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE)) return;
+      for (mword i = 0; i < backoff; i += 1) CPU::Pause();
+      if (backoff < maxBackoff) backoff *= 2;
+      while (locked) CPU::Pause();
+    }
+  }
+  void release() {
+    KASSERT0(!CPU::interruptsEnabled());
+    KASSERT0(check());
+    __atomic_clear(&locked, __ATOMIC_RELEASE);
+  }
+} __caligned;
+
+// MCS queued lock: each waiter spins on its own node from the per-CPU pool
+// 'head' is only accessed by the holder; release may be out of LIFO order
+class MCSSpinLock {
+  MCSNode* volatile tail;
+  MCSNode* head;
+public:
+  MCSSpinLock() : tail(nullptr), head(nullptr) {}
+  bool check() const { return tail != nullptr; }
+  bool tryAcquire() {
+    MCSNode* n = LocalProcessor::allocMCSNode();
+    n->next = nullptr;
+    MCSNode* expected = nullptr;
+    if (__atomic_compare_exchange_n(&tail, &expected, n, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      head = n;
+      return true;
+    }
+    LocalProcessor::freeMCSNode(n);
+    return false;
+  }
+  void acquire() {
+    MCSNode* n = LocalProcessor::allocMCSNode();
+    n->next = nullptr;
+    n->wait = true;
+    MCSNode* pred = __atomic_exchange_n(&tail, n, __ATOMIC_ACQ_REL);
+    if (pred) {
+      __atomic_store_n(&pred->next, n, __ATOMIC_RELEASE);
+      while (__atomic_load_n(&n->wait, __ATOMIC_ACQUIRE)) CPU::Pause();
+    }
+    head = n;
+  }
+  void release() {
+    KASSERT0(check());
+    MCSNode* n = head;
+    MCSNode* next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+      MCSNode* expected = n;
+      if (__atomic_compare_exchange_n(&tail, &expected, nullptr, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        LocalProcessor::freeMCSNode(n);
+        return;
+      }
+      while (!(next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE))) CPU::Pause();
+    }
+    __atomic_store_n(&next->wait, false, __ATOMIC_RELEASE);
+    LocalProcessor::freeMCSNode(n);
+  }
+} __caligned;
+
 template<typename T, T noOwner>
 class OwnerSpinLock {
   volatile T owner;
@@ -105,26 +180,60 @@ public:
   }
 };
 
-class SpinLock : protected BinarySpinLock {
+// interrupt-safe wrapper for a raw spinlock
+template<typename RawLock>
+class IrqSpinLock : protected RawLock {
+#if TESTING_LOCK_PROFILE
+  mword holdStart;
+  mword holdSite;
+#endif
 public:
   bool tryAcquire() {
     LocalProcessor::lock();
-    if (BinarySpinLock::tryAcquire()) return true;
+    if (RawLock::tryAcquire()) {
+#if TESTING_LOCK_PROFILE
+      holdStart = CPU::readTSC();
+      holdSite = LockProfile::acquired(this, 0, false);
+#endif
+      return true;
+    }
     LocalProcessor::unlock();
     return false;
   }
-  void acquire(SpinLock* l = nullptr) {
+  void acquire(IrqSpinLock* l = nullptr) {
     LocalProcessor::lock();
-    BinarySpinLock::acquire();
+#if TESTING_LOCK_PROFILE
+    mword tsc = CPU::readTSC();
+    bool contended = !RawLock::tryAcquire();
+    if (contended) RawLock::acquire();
+    holdStart = CPU::readTSC();
+    holdSite = LockProfile::acquired(this, holdStart - tsc, contended);
+#else
+    RawLock::acquire();
+#endif
     if (l) l->release();
   }
   void release() {
-    BinarySpinLock::release();
+#if TESTING_LOCK_PROFILE
+    LockProfile::released(holdSite, CPU::readTSC() - holdStart);
+#endif
+    RawLock::release();
     LocalProcessor::unlock();
   }
-  bool check() const { return BinarySpinLock::check(); }
+  bool check() const { return RawLock::check(); }
 };
 
+// build-time selection of the lock type used as BasicLock
+#if TESTING_SPINLOCK_MCS
+class SpinLock : public IrqSpinLock<MCSSpinLock> {};
+#elif TESTING_SPINLOCK_TICKET
+class SpinLock : public IrqSpinLock<TicketSpinLock> {};
+#elif TESTING_SPINLOCK_BACKOFF
+class SpinLock : public IrqSpinLock<BackoffSpinLock> {};
+#else
+class SpinLock : public IrqSpinLock<BinarySpinLock> {};
+#endif
+
 class OwnerLock : protected OwnerSpinLock<mword,limit<mword>()> {
 public:
   bool tryAcquire() {
@@ -0,0 +1,73 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/AddressSpace.h"
+#include "kernel/KernelHeap.h"
+#include "kernel/StackPool.h"
+
+StackPool::CpuPool* StackPool::pools = nullptr;
+mword StackPool::poolCpus = 0;
+
+void StackPool::init( mword cpus ) {
+#if TESTING_NEVER_STACKPOOL
+  return;
+#endif
+  CpuPool* cp = knewN<CpuPool>(cpus * classCount);
+  for (mword i = 0; i < cpus * classCount; i += 1) {
+    cp[i].count = cp[i].hits = cp[i].misses = 0;
+  }
+  poolCpus = cpus;
+  __atomic_store_n(&pools, cp, __ATOMIC_RELEASE);
+}
+
+vaddr StackPool::alloc( size_t ss ) {
+  if (pools && pooled(ss)) {
+    LocalProcessor::lock();
+    CpuPool& cp = pools[LocalProcessor::getIndex() * classCount + sizeClass(ss)];
+    if fastpath(cp.count > 0) {
+      cp.hits += 1;
+      vaddr vma = cp.stack[--cp.count];
+      LocalProcessor::unlock();
+      return vma;
+    }
+    cp.misses += 1;
+    LocalProcessor::unlock();
+  }
+  return kernelAS.allocLazyStack(ss);
+}
+
+// called during thread switch: freshly terminated thread's stack is cached
+void StackPool::release( vaddr vma, size_t ss ) {
+  if (pools && pooled(ss)) {
+    LocalProcessor::lock();
+    CpuPool& cp = pools[LocalProcessor::getIndex() * classCount + sizeClass(ss)];
+    if fastpath(cp.count < capacity) {
+      cp.stack[cp.count++] = vma;
+      LocalProcessor::unlock();
+      return;
+    }
+    LocalProcessor::unlock();
+  }
+  kernelAS.releaseStack(vma, ss);
+}
+
+void StackPool::getStats( size_t c, mword& hits, mword& misses ) {
+  hits = misses = 0;
+  for (mword i = 0; i < poolCpus; i += 1) {
+    hits += pools[i * classCount + c].hits;
+    misses += pools[i * classCount + c].misses;
+  }
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _StackPool_h_
+#define _StackPool_h_ 1
+
+#include "generic/basics.h"
+#include "generic/bitmanip.h"
+#include "machine/Memory.h"
+
+/* StackPool: per-CPU caches of mapped kernel stacks per size class; thread
+ * stacks (and the thread objects on top) are recycled without unmapping,
+ * i.e., no VM range, page mapping, or TLB invalidation; misses and
+ * overflow go to kernelAS */
+class StackPool : public NoObject {
+public:
+  static const size_t classCount = 4;   // minimumStack .. 8 * minimumStack
+  static const mword capacity = 16;     // stacks per CPU and size class
+
+private:
+  // only accessed with interrupts disabled
+  struct CpuPool {
+    mword count;
+    mword hits;
+    mword misses;
+    vaddr stack[capacity];
+  };
+  static CpuPool* pools;                // [cpus][classCount]
+  static mword poolCpus;
+
+  static constexpr size_t sizeClass(size_t ss) {
+    return floorlog2(ss) - floorlog2(minimumStack);
+  }
+  static constexpr bool pooled(size_t ss) {
+    return ss >= minimumStack && sizeClass(ss) < classCount && ss == classSize(sizeClass(ss));
+  }
+
+public:
+  static void init( mword cpus );
+  static vaddr alloc( size_t ss );
+  static void release( vaddr vma, size_t ss );
+  static constexpr size_t classSize( size_t c ) { return minimumStack << c; }
+  static void getStats( size_t c, mword& hits, mword& misses );
+};
+
+#endif /* _StackPool_h_ */
@@ -18,23 +18,80 @@
 #define _SystemProcessor_h_ 1
 
 #include "generic/IntrusiveContainers.h"
+#include "runtime/BlockingSync.h"
 #include "runtime/Scheduler.h"
 #include "machine/Processor.h"
 
+class BaseAddressSpace;
+class SystemProcessor;
+
 struct AddressSpaceMarker : public IntrusiveList<AddressSpaceMarker>::Link {
   sword enterEpoch;
+  BaseAddressSpace* as;       // address space currently entered
+  SystemProcessor* proc;      // owner -> shootdown IPI
+};
+
+// per-CPU PCID allocator (cf. AddressSpace::switchTo): recently used address
+// spaces keep their PCID and tagged TLB entries; round-robin replacement
+struct PcidCache {
+  static const mword slots = 16;
+  mword asid[slots];          // address space id, 0: unused
+  sword epoch[slots];         // AS unmap epoch when TLB was last in sync
+  mword curr;                 // current slot, 'slots' for PCID 0 (boot)
+  mword next;
+  PcidCache() : curr(slots), next(0) {
+    for (mword i = 0; i < slots; i += 1) asid[i] = 0;
+  }
+  void leave(sword e) {
+    if (curr < slots) epoch[curr] = e;
+  }
+  // PCID = slot + 1; 'flush', if newly assigned or unmapped since last left
+  mword enter(mword id, sword e, bool& flush) {
+    for (curr = 0; curr < slots; curr += 1) {
+      if (asid[curr] == id) {
+        flush = (epoch[curr] != e);
+        return curr + 1;
+      }
+    }
+    curr = next;
+    next = (next + 1) % slots;
+    asid[curr] = id;
+    flush = true;
+    return curr + 1;
+  }
+};
+
+// per-CPU frames for lazy kernel stack pages: committed on the page fault
+// stack, which must not enter the frame manager (locks might be held);
+// refilled after each thread switch: the previous thread might have drained
+// a full lazy stack, and the refill itself might grow the next thread's stack
+struct FrameReserve {
+  static const mword capacity = 2 * lazyStack / pagesize<stackpl>();
+  paddr frame[capacity];
+  mword count;
+  FrameReserve() : count(0) {}
 };
 
 class SystemProcessor : public Processor {
+  friend class BaseAddressSpace;
   friend class KernelAddressSpace;
   friend class AddressSpace;
   AddressSpaceMarker userASM;
   AddressSpaceMarker kernASM;
+  PcidCache pcids;
+  FrameReserve stackFrames;
   Scheduler scheduler;
+  TimerWheel timerWheel;
+  mword timerIrqs;            // local timer interrupts taken
 public:
-  SystemProcessor() : Processor(this) {}
+  SystemProcessor() : Processor(this), timerIrqs(0) {
+    userASM.proc = kernASM.proc = this;
+  }
   void start(funcvoid0_t func);
   Scheduler& getScheduler() { return scheduler; }
+  TimerWheel& getTimerWheel() { return timerWheel; }
+  void countTimerIrq() { timerIrqs += 1; }
+  mword getTimerIrqs() const { return timerIrqs; }
 };
 
 #endif /* _SystemProcessor_h_ */
@@ -0,0 +1,274 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _VmArea_h_
+#define _VmArea_h_ 1
+
+#include "kernel/KernelHeap.h"
+#include "kernel/Output.h"
+#include "machine/Paging.h"
+
+#include "extern/stl/mod_set"
+
+// virtual memory area: contiguous range with uniform mapping attributes
+struct VmArea : public mod_set_elem<VmArea*> {
+  enum State { Lazy, Alloc, Direct, Guard, Released };
+  vaddr start;
+  vaddr end;
+  State state;
+  Paging::PageType type;
+  size_t ps;                           // reservation granularity (huge pages)
+  VmArea(vaddr s, vaddr e, State st = Released, Paging::PageType t = Paging::Invalid, size_t p = smallps)
+    : start(s), end(e), state(st), type(t), ps(p) {}
+  VmArea(const VmArea&) = default;
+  VmArea& operator=(const VmArea&) = default;
+  bool mergeable(const VmArea& a) const {
+    return state == a.state && type == a.type && ps == a.ps && (state == Lazy || state == Alloc);
+  }
+  struct Less {
+    bool operator()(const VmArea* a, const VmArea* b) const { return a->start < b->start; }
+  };
+};
+
+// free range between areas, ordered by size (then address) for best fit
+struct VmHole : public mod_set_elem<VmHole*> {
+  vaddr start;
+  vaddr end;
+  VmHole(vaddr s, vaddr e) : start(s), end(e) {}
+  VmHole(const VmHole&) = default;
+  VmHole& operator=(const VmHole&) = default;
+  size_t size() const { return end - start; }
+  struct Less {
+    bool operator()(const VmHole* a, const VmHole* b) const {
+      return a->size() < b->size() || (a->size() == b->size() && a->start < b->start);
+    }
+  };
+};
+
+inline ostream& operator<<(ostream& os, const VmArea& a) {
+  os << FmtHex(a.start) << '-' << FmtHex(a.end) << '/' << "LADGR"[a.state];
+  return os;
+}
+
+// Areas and holes partition [bottom,top): every range in between belongs to
+// exactly one area or hole.  Released areas are unmapped, but not yet
+// invalidated in all TLBs; they turn into holes via 'reclaim'.  All
+// operations are O(log n) in the number of areas; caller provides locking.
+class VmAreaSet {
+  VmAreaSet(const VmAreaSet&) = delete;            // no copy
+  VmAreaSet& operator=(const VmAreaSet&) = delete; // no assignment
+
+  IntrusiveStdSet<VmArea*,VmArea::Less> areas;
+  IntrusiveStdSet<VmHole*,VmHole::Less> holes;
+  HeapCache<sizeof(VmArea)> areaCache;
+  HeapCache<sizeof(VmHole)> holeCache;
+  vaddr bottom, top;
+
+  typedef IntrusiveStdSet<VmArea*,VmArea::Less>::iterator AreaIter;
+
+  void addHole(vaddr s, vaddr e) {
+    if (s < e) holes.insert(new (holeCache.allocate()) VmHole(s, e));
+  }
+
+  void removeHole(vaddr s, vaddr e) {
+    VmHole key(s, e);
+    auto it = holes.find(&key);
+    KASSERTN(it != holes.end(), FmtHex(s), '-', FmtHex(e));
+    VmHole* h = *it;
+    holes.erase(it);
+    holeCache.deallocate(h);
+  }
+
+  // first area with start > addr
+  AreaIter after(vaddr addr) {
+    VmArea key(addr, addr);
+    return areas.upper_bound(&key);
+  }
+
+  // first area with start >= addr
+  AreaIter first(vaddr addr) {
+    VmArea key(addr, addr);
+    return areas.lower_bound(&key);
+  }
+
+  // boundaries of hole that would contain [s,e), if free
+  bool freeRange(vaddr s, vaddr e, vaddr& hs, vaddr& he) {
+    if (s < bottom || e > top || s >= e) return false;
+    AreaIter it = after(s);
+    he = (it == areas.end()) ? top : (*it)->start;
+    if (he < e) return false;
+    if (it == areas.begin()) hs = bottom;
+    else { --it; hs = (*it)->end; }
+    return hs <= s;
+  }
+
+  // split area containing 'addr' at 'addr', if any
+  void split(vaddr addr) {
+    AreaIter it = after(addr);
+    if (it == areas.begin()) return;
+    VmArea* a = *(--it);
+    if (addr <= a->start || addr >= a->end) return;
+    VmArea* b = new (areaCache.allocate()) VmArea(*a);
+    b->start = addr;
+    a->end = addr;
+    areas.insert(b);
+  }
+
+  // merge 'a' with adjacent areas of equal attributes
+  void merge(VmArea* a) {
+    AreaIter it = areas.find(a);
+    if (it != areas.begin()) {
+      AreaIter pit = it;
+      VmArea* p = *(--pit);
+      if (p->end == a->start && p->mergeable(*a)) {
+        p->end = a->end;
+        areas.erase(it);
+        areaCache.deallocate(a);
+        a = p;
+        it = areas.find(a);
+      }
+    }
+    if (++it != areas.end()) {
+      VmArea* n = *it;
+      if (a->end == n->start && a->mergeable(*n)) {
+        a->end = n->end;
+        areas.erase(it);
+        areaCache.deallocate(n);
+      }
+    }
+  }
+
+  void insert(vaddr s, vaddr e, VmArea::State st, Paging::PageType t, size_t ps) {
+    VmArea* a = new (areaCache.allocate()) VmArea(s, e, st, t, ps);
+    areas.insert(a);
+    merge(a);
+  }
+
+public:
+  VmAreaSet() : bottom(0), top(0) {}
+  ~VmAreaSet() { clear(); }
+
+  void clear() {
+    while (!areas.empty()) {
+      VmArea* a = *areas.begin();
+      areas.erase(areas.begin());
+      areaCache.deallocate(a);
+    }
+    while (!holes.empty()) {
+      VmHole* h = *holes.begin();
+      holes.erase(holes.begin());
+      holeCache.deallocate(h);
+    }
+  }
+
+  void init(vaddr bot, vaddr tp) {
+    KASSERT0(areas.empty());
+    clear();
+    bottom = bot;
+    top = tp;
+    addHole(bottom, top);
+  }
+
+  // duplicate (fork): released areas are unmapped already -> holes
+  void copy(const VmAreaSet& src) {
+    clear();
+    init(src.bottom, src.top);
+    for (auto it = src.areas.begin(); it != src.areas.end(); ++it) {
+      const VmArea* a = *it;
+      if (a->state == VmArea::Released) continue;
+      vaddr hs, he;
+      bool free = freeRange(a->start, a->end, hs, he);
+      KASSERTN(free, *a);
+      removeHole(hs, he);
+      addHole(hs, a->start);
+      addHole(a->end, he);
+      insert(a->start, a->end, a->state, a->type, a->ps);
+    }
+  }
+
+  bool contains(vaddr addr) const { return bottom <= addr && addr < top; }
+
+  VmArea* find(vaddr addr) {
+    AreaIter it = after(addr);
+    if (it == areas.begin()) return nullptr;
+    VmArea* a = *(--it);
+    return (addr < a->end) ? a : nullptr;
+  }
+
+  // top-down best fit, at 'hint' if free; 'guard' bytes at bottom of range
+  // become a separate guard area (stacks); returns topaddr if exhausted
+  vaddr alloc(vaddr hint, size_t size, size_t align, VmArea::State st, Paging::PageType t, size_t guard = 0) {
+    KASSERT1(aligned(size, align), size);
+    KASSERTN(guard < size, guard, ' ', size);
+    vaddr start = align_down(hint, align);
+    vaddr hs, he;
+    if (!hint || !freeRange(start, start + size, hs, he)) {
+      VmHole key(0, size + align - smallps);
+      auto it = holes.lower_bound(&key);
+      if (it == holes.end()) return topaddr;
+      hs = (*it)->start;
+      he = (*it)->end;
+      start = align_down(he - size, align);
+      KASSERTN(start >= hs, FmtHex(hs), '-', FmtHex(he), ' ', FmtHex(size));
+    }
+    removeHole(hs, he);
+    addHole(hs, start);
+    addHole(start + size, he);
+    if (guard) insert(start, start + guard, VmArea::Guard, t, smallps);
+    insert(start + guard, start + size, st, t, align);
+    DBG::outl(DBG::VM, "VmAreaSet/alloc: ", FmtHex(start), '-', FmtHex(start + size), " state:", st);
+    return start;
+  }
+
+  // mark [s,e) released; fails, if not completely covered by live areas
+  bool release(vaddr s, vaddr e) {
+    if (s < bottom || e > top || s >= e) return false;
+    AreaIter it = after(s);
+    if (it == areas.begin()) return false;
+    --it;
+    for (vaddr next = s; next < e; ++it) {
+      if (it == areas.end() || (*it)->start > next || (*it)->end <= next) return false;
+      if ((*it)->state == VmArea::Released) return false;
+      next = (*it)->end;
+    }
+    split(s);
+    split(e);
+    for (it = first(s); it != areas.end() && (*it)->start < e; ++it) (*it)->state = VmArea::Released;
+    DBG::outl(DBG::VM, "VmAreaSet/release: ", FmtHex(s), '-', FmtHex(e));
+    return true;
+  }
+
+  // released range [s,e) invalidated everywhere: convert to hole
+  void reclaim(vaddr s, vaddr e) {
+    if (s < bottom || e > top) return;
+    AreaIter it = first(s);
+    while (it != areas.end() && (*it)->start < e) {
+      VmArea* a = *it;
+      KASSERTN(a->state == VmArea::Released && a->end <= e, *a);
+      areas.erase(it++);
+      areaCache.deallocate(a);
+    }
+    vaddr hs, he;
+    bool free = freeRange(s, e, hs, he);
+    KASSERTN(free, FmtHex(s), '-', FmtHex(e));
+    if (hs < s) removeHole(hs, s);
+    if (e < he) removeHole(e, he);
+    addHole(hs, he);
+    DBG::outl(DBG::VM, "VmAreaSet/reclaim: ", FmtHex(s), '-', FmtHex(e), " hole:", FmtHex(hs), '-', FmtHex(he));
+  }
+};
+
+#endif /* _VmArea_h_ */
@@ -17,6 +17,7 @@
 #include "runtime/Scheduler.h"
 #include "runtime/Thread.h"
 #include "kernel/Clock.h"
+#include "kernel/Futex.h"
 #include "kernel/Output.h"
 #include "kernel/Process.h"
 #include "world/Access.h"
@@ -123,10 +124,20 @@ extern "C" pid_t getcid() {
 }
 
 extern "C" int usleep(useconds_t usecs) {
-  Timeout::sleep(Clock::now() + usecs);
+  Timeout::sleepNanos(Clock::nanos() + mword(usecs) * 1000);
   return 0;
 }
 
+// transparent huge pages: large anonymous regions reserved at 2M granularity,
+// faulted in as 2M pages if available (cf. Paging::mapFromLazy)
+static inline bool hugeMapping(size_t len) {
+#if TESTING_NEVER_HUGEPAGES
+  return false;
+#else
+  return len >= kernelps;
+#endif
+}
+
 extern "C" int _mmap(void** addr, size_t len, int protflags, int fildes, off_t off) {
   // TODO: validate addr
   int prot = protflags & 0xf;
@@ -135,14 +146,17 @@ extern "C" int _mmap(void** addr, size_t len, int protflags, int fildes, off_t o
   KASSERT1(flags == 0, flags);
   KASSERT1(fildes == -1, fildes);
   KASSERT1(off == 0, off);
-  vaddr va = CurrProcess().mmap<smallpl>(vaddr(*addr), len);
-  if (va == topaddr) return -ENOMEM; // shouldn't happen currently...
+  vaddr va;
+  if (hugeMapping(len)) va = CurrProcess().mmap<kernelpl>(vaddr(*addr), len);
+  else va = CurrProcess().mmap<smallpl>(vaddr(*addr), len);
+  if (va == topaddr) return -ENOMEM;
   *addr = (void*)va;
   return 0;
 }
 
+// region might contain huge pages, even if 'len' is small (malloc trimming)
 extern "C" int _munmap(void* addr, size_t len) {
-  CurrProcess().munmap<smallpl>(vaddr(addr), len);
+  if (!CurrProcess().munmapMixed(vaddr(addr), len)) return -EINVAL;
   return 0;
 }
 
@@ -204,6 +218,36 @@ extern "C" int semV(mword sid) {
   return 0;
 }
 
+static inline bool futexAddr(mword* addr) {
+  return aligned(vaddr(addr), sizeof(mword)) && vaddr(addr) >= userbot && vaddr(addr) < usertop;
+}
+
+extern "C" int futexWait(mword* addr, mword expected, mword timeout) {
+  if (!futexAddr(addr)) return -EINVAL;
+  mword ticks = timeout;
+  if (timeout != 0 && timeout != limit<mword>()) {
+    mword now = Clock::nanos();
+    if (timeout >= limit<mword>() - now) ticks = limit<mword>(); // saturate: no timeout
+    else ticks = Clock::nanosToTick(now + timeout) + 1;
+  }
+  return Futex::wait(&CurrProcess(), vaddr(addr), expected, ticks);
+}
+
+extern "C" int futexWake(mword* addr, mword n) {
+  if (!futexAddr(addr)) return -EINVAL;
+  return Futex::wake(&CurrProcess(), vaddr(addr), n);
+}
+
+extern "C" int futexRequeue(mword* addr, mword n, mword* addr2, mword m, mword expected) {
+  if (!futexAddr(addr) || !futexAddr(addr2)) return -EINVAL;
+  return Futex::requeue(&CurrProcess(), vaddr(addr), n, vaddr(addr2), m, expected);
+}
+
+// monotonic nanoseconds since boot; converted to timespec in user space
+extern "C" ssize_t _clock_gettime() {
+  return Clock::nanos();
+}
+
 typedef int (*funcint4_t)(mword, mword, mword, mword);
 extern "C" int privilege(ptr_t func, mword a1, mword a2, mword a3, mword a4) {
   return ((funcint4_t)func)(a1, a2, a3, a4);
@@ -214,6 +258,10 @@ extern "C" void _init_sig_handler(vaddr sighandler) {
   CurrProcess().setSignalHandler(sighandler);
 }
 
+extern "C" pid_t fork() {
+  return CurrProcess().fork();
+}
+
 /******* dummy functions *******/
 
 extern "C" int fstat(int fildes, struct stat *buf) {
@@ -262,7 +310,12 @@ static const syscall_t syscalls[] = {
   syscall_t(semP),
   syscall_t(semV),
   syscall_t(privilege),
-  syscall_t(_init_sig_handler)
+  syscall_t(_init_sig_handler),
+  syscall_t(fork),
+  syscall_t(futexWait),
+  syscall_t(futexWake),
+  syscall_t(futexRequeue),
+  syscall_t(_clock_gettime)
 };
 
 static_assert(sizeof(syscalls)/sizeof(syscall_t) == SyscallNum::max, "syscall list error");
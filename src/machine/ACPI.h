@@ -36,7 +36,8 @@ static set<pair<vaddr,size_t>> mappings;
 }
 
 static paddr initACPI(vaddr r, map<uint32_t,uint32_t>&, map<uint32_t,paddr>&,
-  map<uint8_t,pair<uint32_t,uint16_t>>&)                                __section(".boot.text");
+  map<uint8_t,pair<uint32_t,uint16_t>>&, map<uint32_t,uint32_t>&,
+  map<paddr,pair<paddr,uint32_t>>&)                                     __section(".boot.text");
 static void initACPI2()                                                 __section(".boot.text");
 static ACPI_DEVICE_INFO* acpiGetInfo(ACPI_HANDLE)                       __section(".boot.text");
 static ACPI_STATUS walkHandler(ACPI_HANDLE, UINT32, void*, void**)      __section(".boot.text");
@@ -47,7 +48,9 @@ static ACPI_STATUS pciInterruptLink(ACPI_HANDLE, UINT32, void*, void**) __sectio
 
 static paddr initACPI(vaddr r, map<uint32_t,uint32_t>& apicMap,
   map<uint32_t,paddr>& ioApicMap,
-  map<uint8_t,pair<uint32_t,uint16_t>>& ioOverrideMap ) {
+  map<uint8_t,pair<uint32_t,uint16_t>>& ioOverrideMap,
+  map<uint32_t,uint32_t>& cpuDomainMap,
+  map<paddr,pair<paddr,uint32_t>>& memDomainMap ) {
 
   rsdp = r;                           // set up for acpica callback
 
@@ -60,9 +63,42 @@ static paddr initACPI(vaddr r, map<uint32_t,uint32_t>& apicMap,
   // PS/2 driver is enabled in initBSP2, regardless of what ACPI reports
   DBG::outl(DBG::Acpi);
 
-  acpi_table_srat* srat;
+  acpi_table_srat* srat;              // SRAT reports NUMA proximity domains
   if (AcpiGetTable((char*)ACPI_SIG_SRAT, 0, (ACPI_TABLE_HEADER**)&srat ) == AE_OK) {
-    DBG::outl(DBG::Acpi, "SRAT: ", srat->Header.Length);
+    mword sratLength = srat->Header.Length - sizeof(acpi_table_srat);
+    DBG::out1(DBG::Acpi, "SRAT: ", sratLength);
+    acpi_subtable_header* subtable = (acpi_subtable_header*)(srat + 1);
+    while (sratLength > 0) {
+      KASSERTN(subtable->Length <= sratLength, subtable->Length, '/', sratLength);
+      switch (subtable->Type) {
+      case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+        acpi_srat_cpu_affinity* ca = (acpi_srat_cpu_affinity*)subtable;
+        uint32_t domain = ca->ProximityDomainLo
+          | uint32_t(ca->ProximityDomainHi[0]) << 8
+          | uint32_t(ca->ProximityDomainHi[1]) << 16
+          | uint32_t(ca->ProximityDomainHi[2]) << 24;
+        DBG::out1(DBG::Acpi, " CPU:", mword(ca->ApicId), '/', domain);
+        if (ca->Flags & ACPI_SRAT_CPU_USE_AFFINITY) cpuDomainMap.insert( {ca->ApicId, domain} );
+      } break;
+      case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+        acpi_srat_x2apic_cpu_affinity* xa = (acpi_srat_x2apic_cpu_affinity*)subtable;
+        DBG::out1(DBG::Acpi, " X2CPU:", mword(xa->ApicId), '/', xa->ProximityDomain);
+        if (xa->Flags & ACPI_SRAT_CPU_ENABLED) cpuDomainMap.insert( {xa->ApicId, xa->ProximityDomain} );
+      } break;
+      case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+        acpi_srat_mem_affinity* ma = (acpi_srat_mem_affinity*)subtable;
+        DBG::out1(DBG::Acpi, " MEM:", FmtHex(ma->BaseAddress), '/', FmtHex(ma->Length), '/', ma->ProximityDomain);
+        if ((ma->Flags & ACPI_SRAT_MEM_ENABLED) && ma->Length > 0) {
+          memDomainMap.insert( {ma->BaseAddress, {ma->BaseAddress + ma->Length, ma->ProximityDomain}} );
+        }
+      } break;
+      default:
+        DBG::out1(DBG::Acpi, " type ", mword(subtable->Type)); break;
+      }
+      sratLength -= subtable->Length;
+      subtable = (acpi_subtable_header*)(((char*)subtable) + subtable->Length);
+    }
+    DBG::outl(DBG::Acpi);
   }
 
   acpi_table_slit* slit;
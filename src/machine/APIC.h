@@ -123,6 +123,7 @@ class APIC : public NoObject {
     const BitString<uint32_t,24,8> DestField;
 
   __aligned(0x10) volatile uint32_t LVT_Timer;         // 0x320
+    const BitString<uint32_t, 0,8> TimerVector;
     const BitString<uint32_t,16,1> MaskTimer;
     const BitString<uint32_t,17,2> TimerMode;
 
@@ -156,12 +157,15 @@ class APIC : public NoObject {
     AllExclSelf = 0b11
   };
 
-  enum TimerModes { //
+public:
+  enum TimerModes { // Intel Vol. 3, Section 10.5.4 "APIC Timer"
     OneShot  = 0b00,
     Periodic = 0b01,
     Deadline = 0b10
   };
 
+private:
+
   void ipi(uint32_t high, uint32_t low, bool broadcast) {
     if (broadcast) low |= DestinationShorthand.put(AllExclSelf);
     ICR_HIGH = high;
@@ -199,18 +203,18 @@ public:
   void maskTimer() {
     LVT_Timer |= MaskTimer();
   }
-		
-	void timer_perf() {
-    LVT_Timer = 0x200F1;
-    InitialCount = 0xFFFF;
-    DivideConfiguration = 0xA;
+  void setTimer(uint8_t vec, uint32_t count, TimerModes mode, bool masked = false) {
+    DivideConfiguration = 0b0011;       // divide bus clock by 16
+    LVT_Timer = TimerVector.put(vec) | TimerMode.put(mode) | (masked ? MaskTimer() : 0);
+    InitialCount = count;
   }
-	void timer_perf_clear() {
-    LVT_Timer = 0x0;
-    InitialCount = 0x0;
-    DivideConfiguration = 0x0;
+  uint32_t getTimerInitial() {
+    return InitialCount;
   }
-	
+  uint32_t getTimerCurrent() {
+    return CurrentCount;
+  }
+
 	void sendInitIPI(uint8_t dest, bool broadcast = false) {
     ipi(DestField.put(dest), DeliveryMode.put(Init), broadcast);
   }
@@ -223,10 +227,12 @@ public:
   void sendIPI(uint8_t dest, uint8_t vec, bool broadcast = false) {
     ipi(DestField.put(dest), DeliveryMode.put(Fixed) | Vector.put(vec), broadcast);
   }
-  static const uint8_t WakeIPI    = 0xe0; // remote wakeup
-  static const uint8_t PreemptIPI = 0xed; // preemption
-  static const uint8_t TestIPI    = 0xee; // test IPI: bootstrap & experiment
-  static const uint8_t StopIPI    = 0xef; // stop, used for GDB or reboot
+  static const uint8_t WakeIPI      = 0xe0; // remote wakeup
+  static const uint8_t ShootdownIPI = 0xec; // TLB shootdown
+  static const uint8_t PreemptIPI   = 0xed; // preemption
+  static const uint8_t TestIPI      = 0xee; // test IPI: bootstrap & experiment
+  static const uint8_t StopIPI      = 0xef; // stop, used for GDB or reboot
+  static const uint8_t TimerIRQ     = 0xf1; // local timer: preemption, sampling
 } __packed;
 
 
@@ -16,6 +16,19 @@
 ******************************************************************************/
 #include "machine/CPU.h"
 
+bool CPUID::pcid = false;
+
+// per core; requires CR3[11:0] == 0 at this point (Intel Vol. 3, 4.10.1)
+bool CPUID::enablePCID() {
+#if TESTING_NEVER_PCID
+  return false;
+#endif
+  if (!PCID()) return false;
+  CPU::writeCR4(CPU::readCR4() | CPU::PCIDE());
+  pcid = true;
+  return true;
+}
+
 void CPUID::getCacheInfo() {
   // TODO: see Intel Processor Identification and the CPUID Instruction
   // Section 5.1.3 "Cache Descriptors (Function 02h)", page 30
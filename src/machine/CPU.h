@@ -148,6 +148,22 @@ namespace CPU {
     asm volatile("mfence" ::: "memory");
   }
 
+  // zero with non-temporal stores (bypass caches), 'size' multiple of 64
+  static inline void StreamZero(vaddr addr, size_t size) {
+    for (vaddr end = addr + size; addr < end; addr += 64) {
+      asm volatile("movnti %1,   (%0)\n\t"
+                   "movnti %1,  8(%0)\n\t"
+                   "movnti %1, 16(%0)\n\t"
+                   "movnti %1, 24(%0)\n\t"
+                   "movnti %1, 32(%0)\n\t"
+                   "movnti %1, 40(%0)\n\t"
+                   "movnti %1, 48(%0)\n\t"
+                   "movnti %1, 56(%0)"
+                   :: "r"(addr), "r"(mword(0)) : "memory");
+    }
+    StoreFence();                      // order with later regular stores
+  }
+
   static inline void InvTLB(mword val) {
     // Somehow the extra move into a register seems to be necessary to
     // to make invlpg work reliably (e.g. bochs, but also observed on HW),
@@ -212,6 +228,17 @@ namespace CPU {
   static const BitString<mword,18,1> OSXSAVE;
   static const BitString<mword,20,1> SMEP;
 
+  // full TLB flush: CR3 reload keeps G pages, toggling CR4.PGE does not
+  static inline void FlushTLB(bool global) {
+    if (global) {
+      mword cr4 = readCR4();
+      writeCR4(cr4 & ~PGE());
+      writeCR4(cr4);
+    } else {
+      writeCR3(readCR3());
+    }
+  }
+
   static inline mword readCR8() {
     mword val; asm volatile("mov %%cr8, %0" : "=r"(val) :: "cc"); return val;
   }
@@ -315,7 +342,13 @@ class CPUID : public NoObject {
   static inline bool NX()        { return cpuid(0x80000001).d & bitmask<uint32_t>(20,1); }
   static inline bool SYSCALL()   { return cpuid(0x80000001).d & bitmask<uint32_t>(11,1); }
   static inline bool Page1G()    { return cpuid(0x80000001).d & bitmask<uint32_t>(26,1); }
+  static inline bool PCID()      { return cpuid(0x00000001).c & bitmask<uint32_t>(17,1); }
   void getCacheInfo()                                 __section(".boot.text");
+
+  static bool pcid;
+  static bool enablePCID()                            __section(".boot.text");
+public:
+  static bool pcidEnabled() { return pcid; }
 };
 
 // TODO: query PMU capabilities using CPUID (see Intel Vol. 3, Chap 18)
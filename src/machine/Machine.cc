@@ -20,6 +20,7 @@
 #include "kernel/KernelHeap.h"
 #include "kernel/Multiboot.h"
 #include "kernel/Process.h"
+#include "kernel/StackPool.h"
 #include "machine/asmdecl.h"
 #include "machine/APIC.h"
 #include "machine/Machine.h"
@@ -92,6 +93,12 @@ static InterruptDescriptor idt[maxIDT]                      __aligned(smallps);
 // CPU information
 mword Machine::processorCount = 0;
 SystemProcessor* Machine::processorTable = nullptr;
+
+// local APIC timer: 1 tick = 1ms for timer wheel, quantum in ticks
+static const mword calibrationTime = 10;   // ms
+static const paddr bootMemLimit = 0x4000000; // boot memory -> node 0
+mword Machine::timerTicks = 0;
+mword Machine::quantum = 4;
 static mword bspIndex = ~mword(0);
 static mword bspApicID = ~mword(0);
 
@@ -131,6 +138,7 @@ void Machine::initAP2() {
   apIndex = bspIndex;                          // sync with BSP
   DBG::outl(DBG::Boot, "Enabling AP interrupts...");
   LocalProcessor::initInterrupts(false);       // enable interrupts (off boot stack)
+  startTimer();                                // per-core preemption timer
   DBG::outl(DBG::Boot, "Finishing AP boot thread...");
   CurrThread()->terminate(); // idle thread takes over
 }
@@ -250,9 +258,15 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
 
   // initialize frame manager after rerun of constructors
   frameManager.init((bufptr_t)(kerneltop - fmMemory));
-  // populate frame manager
+  // populate frame manager with boot memory; rest after NUMA info is known
+  RegionSet<Region<paddr>> numaMem;
   for ( auto it = mem.begin(); it != mem.end(); ++it ) {
-    frameManager.release(it->start, it->end - it->start);
+    if (it->start < bootMemLimit) {
+      frameManager.release(it->start, min(it->end, bootMemLimit) - it->start);
+    }
+    if (it->end > bootMemLimit) {
+      numaMem.insert( Region<paddr>(max(it->start, bootMemLimit), it->end) );
+    }
   }
   // now frame manager can initialize zeroing AS <- needs page mappings
   while (frameManager.zeroMemory());
@@ -262,9 +276,45 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
   map<uint32_t,uint32_t> apicMap;
   map<uint32_t,paddr> ioApicMap;
   map<uint8_t,pair<uint32_t,uint16_t>> ioOverrideMap;
-  paddr apicPhysAddr = initACPI(rsdp, apicMap, ioApicMap, ioOverrideMap);
+  map<uint32_t,uint32_t> cpuDomainMap;
+  map<paddr,pair<paddr,uint32_t>> memDomainMap;
+  paddr apicPhysAddr = initACPI(rsdp, apicMap, ioApicMap, ioOverrideMap, cpuDomainMap, memDomainMap);
   DBG::outl(DBG::Boot, "ACPI parsing done");
 
+  // NUMA: one frame manager per proximity domain, in order of memory address
+  // -> node 0 (boot memory) is 'frameManager'; without SRAT, only node 0
+  map<uint32_t,mword> domainNode;
+  FrameManager::addNode(frameManager);
+  for (const auto& md : memDomainMap) {
+    uint32_t domain = md.second.second;
+    if (domainNode.count(domain)) continue;
+    mword node = domainNode.size();
+    domainNode.insert( {domain, node} );
+    if (node == 0) continue;
+    FrameManager* fm = knew<FrameManager>();
+    size_t fms = fm->preinit(0, topphysmem);
+    fm->init(bufptr_t(kmalloc<buf_t>(fms)));
+    FrameManager::addNode(*fm);
+  }
+  for (const auto& md : memDomainMap) {
+    FrameManager::addRange(md.first, md.second.first, domainNode.at(md.second.second));
+  }
+  // release remaining memory, split at node boundaries -> owner node
+  for (const Region<paddr>& r : numaMem) {
+    for (paddr start = r.start; start < r.end; ) {
+      paddr next = r.end;
+      for (const auto& md : memDomainMap) {
+        if (md.first > start) next = min(next, align_up(md.first, smallps));
+        if (md.second.first > start) next = min(next, align_up(md.second.first, smallps));
+      }
+      frameManager.release(start, next - start);
+      start = next;
+    }
+  }
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) {
+    DBG::outl(DBG::Boot, "FM/node ", n, ": ", FmtHex(FrameManager::getNode(n).getFree()), " free");
+  }
+
   // process IOAPIC/IRQ information -> mask all IOAPIC interrupts for now
   for (const pair<uint32_t,paddr>&iop : ioApicMap) {
     Paging::mapPage<smallpl>(ioApicAddr, iop.second, Paging::MMapIO, _friend<Machine>());
@@ -295,14 +345,40 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
   for (const pair<uint32_t,uint32_t>& ap : apicMap) {
     SystemProcessor& p = processorTable[ coreIdx];
     SystemProcessor& q = processorTable[(coreIdx + 1) % processorCount];
-    p.setup(coreIdx, ap.second, ap.first, frameManager);
+    FrameManager* fm = &frameManager;  // local node's frame manager
+    auto cd = cpuDomainMap.find(ap.second);
+    if (cd != cpuDomainMap.end() && domainNode.count(cd->second)) {
+      fm = &FrameManager::getNode(domainNode.at(cd->second));
+    }
+    p.setup(coreIdx, ap.second, ap.first, *fm);
     p.getScheduler().setPeer(q.getScheduler());
-    DBG::outl(DBG::Boot, "Scheduler ", coreIdx, " at ", FmtHex(&p.getScheduler()));
+    DBG::outl(DBG::Boot, "Scheduler ", coreIdx, " at ", FmtHex(&p.getScheduler()), " node ", fm->getNode());
     coreIdx += 1;
   }
 
-  // complete paging setup for memory zeroing, if core count > 512
-  Paging::bootstrap3(processorCount, _friend<Machine>());
+  // per-CPU magazine caches for kernel heap, stacks, and frame caches
+  KernelHeap::initCaches(processorCount);
+  StackPool::init(processorCount);
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) {
+    FrameManager::getNode(n).initCaches(processorCount);
+  }
+
+  // work stealing: victims ordered by distance in core index (~ topology)
+  for (mword idx = 0; idx < processorCount; idx += 1) {
+    BaseScheduler** victims = knewN<BaseScheduler*>(processorCount - 1);
+    mword vc = 0;
+    for (mword d = 1; vc < processorCount - 1; d += 1) {
+      victims[vc++] = &processorTable[(idx + d) % processorCount].getScheduler();
+      if (vc < processorCount - 1) {
+        victims[vc++] = &processorTable[(idx + processorCount - d) % processorCount].getScheduler();
+      }
+    }
+    processorTable[idx].getScheduler().setVictims(victims, vc);
+  }
+
+  // complete paging setup for memory zeroing: two windows per core (cf.
+  // zeroWindow in FrameManager.h), extra page directories beyond 512
+  Paging::bootstrap3(2 * processorCount, _friend<Machine>());
 
   // map APIC page, use APIC ID to determine bspIndex
   Paging::mapPage<smallpl>(apicAddr, apicPhysAddr, Paging::MMapIO, _friend<Machine>());
@@ -327,7 +403,7 @@ void Machine::initBSP2() {
   initGdb(bspIndex);
 
   DBG::outl(DBG::Boot, "Initializing basic devices...");
-  // init RTC timer; used for preemption & sleeping
+  // init RTC timer; used for sleeping
   rtc.init();
   // init PIT timer; used for waiting
   pit.init();
@@ -339,12 +415,21 @@ void Machine::initBSP2() {
   Paging::mapPage<smallpl>(videoAddr, Paging::vtop(Screen::getAddress(_friend<Machine>())), Paging::MMapIO, _friend<Machine>());
   Screen::setAddress(videoAddr, _friend<Machine>());
 
+  // shared zero page: read faults on lazy anonymous memory
+#if !TESTING_NEVER_ZEROPAGE
+  Paging::initZeroPage(CurrFM(), _friend<Machine>());
+#endif
+
   DBG::outl(DBG::Boot, "********** MULTI CORE **********");
 
   // enable interrupts (off boot stack); needed for timer waiting
   DBG::outl(DBG::Boot, "Enabling BSP interrupts...");
   LocalProcessor::initInterrupts(true);
 
+  // calibrate APIC timer against PIT, then start preemption on BSP
+  calibrateTimer();
+  startTimer();
+
   // send test IPI to self <- reception needs interrupts enabled
   tipiTest = false;
   tipiHandler = tipiReceiver;
@@ -381,6 +466,10 @@ apDone:
   }
   StdOut.print<false>(kendl);
 
+  // all processors have a page fault stack now -> lazy kernel stacks
+  setupIDT(0x0e, (vaddr)&isr_wrapper_0x0e, Processor::pfIST);
+  kernelAS.enableLazyStacks(_friend<Machine>());
+
   DBG::outl(DBG::Boot, "Building kernel filesystem...");
   // initialize kernel file system with boot modules
   Multiboot::readModules(kernelBase);
@@ -406,11 +495,70 @@ apDone:
   // find and install CDI drivers for PCI devices - need interrupts for sleep
   for (const PCIDevice& pd : pciDevList) findCdiDriver(pd);
 
+  // one background zeroing thread per node, on the node's first core
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) {
+    FrameManager& fm = FrameManager::getNode(n);
+    for (mword i = 0; i < processorCount; i += 1) {
+      if (&processorTable[i].getFrameManager() != &fm) continue;
+      fm.startZeroing(processorTable[i].getScheduler());
+      break;
+    }
+  }
+
   // start irq thread after cdi init -> avoid interference from device irqs
   DBG::outl(DBG::Boot, "Creating IRQ thread...");
   Thread::create()->setPriority(topPriority)->setScheduler(processorTable[0].getScheduler())->setAffinity(true)->start((ptr_t)asyncIrqLoop);
 }
 
+// calibrate APIC timer and TSC clocksource against PIT
+void Machine::calibrateTimer() {
+  Clock::wait(1);                      // align with PIT tick
+  MappedAPIC()->setTimer(APIC::TimerIRQ, limit<uint32_t>(), APIC::OneShot, true);
+  mword tsc = CPU::readTSC();
+  Clock::wait(calibrationTime);
+  tsc = CPU::readTSC() - tsc;
+  timerTicks = (limit<uint32_t>() - MappedAPIC()->getTimerCurrent()) / calibrationTime;
+  MappedAPIC()->maskTimer();
+  KASSERT0(timerTicks);
+  Clock::calibrate(tsc, calibrationTime);
+  DBG::outl(DBG::Boot, "APIC timer: ", timerTicks, " counts/ms, quantum: ", quantum, " ticks");
+  DBG::outl(DBG::Boot, "TSC clock: ", tsc / calibrationTime, " cycles/ms");
+
+  // self-test: TSC clock vs. PIT over another calibration period
+  Clock::wait(1);
+  mword ns = Clock::nanos();
+  Clock::wait(calibrationTime);
+  ns = Clock::nanos() - ns;
+  mword expected = calibrationTime * Clock::nsPerTick;
+  mword error = ns > expected ? ns - expected : expected - ns;
+  KCHECKN(error < expected / 20, "TSC clock off by ", error, "ns in ", calibrationTime, "ms");
+}
+
+// update: only reprogram, if one-shot timer from tickless idle
+void Machine::startTimer(bool update) {
+  if (update && MappedAPIC()->getTimerInitial() == timerTicks) return;
+  MappedAPIC()->setTimer(APIC::TimerIRQ, timerTicks, APIC::Periodic);
+}
+
+void Machine::setQuantum(mword q) {
+  KASSERT1(q > 0, q);
+  quantum = q;
+}
+
+// tickless idle: no periodic interrupts, one-shot for next timeout (ms)
+void Machine::idleTimer(mword deadline) {
+#if TESTING_NEVER_TICKLESS
+  return;
+#endif
+  if (deadline == limit<mword>()) {
+    MappedAPIC()->maskTimer();
+    return;
+  }
+  mword now = Clock::now();
+  mword count = deadline > now ? (deadline - now) * timerTicks : 1;
+  MappedAPIC()->setTimer(APIC::TimerIRQ, min(count, mword(limit<uint32_t>())), APIC::OneShot);
+}
+
 void Machine::bootCleanup() {
   DBG::outl(DBG::Boot, "********* MEMORY CLEANUP *********");
 
@@ -552,7 +700,7 @@ void Machine::setupIDTable() {
   setupIDT(0x0b, (vaddr)&isr_wrapper_0x0b);
   setupIDT(0x0c, (vaddr)&isr_wrapper_0x0c, Processor::stfIST); // stack fault
   setupIDT(0x0d, (vaddr)&isr_wrapper_0x0d); // general protection fault
-  setupIDT(0x0e, (vaddr)&isr_wrapper_0x0e); // no page fault stack to support nested page faults
+  setupIDT(0x0e, (vaddr)&isr_wrapper_0x0e); // page fault stack set after AP boot, cf. initBSP2
   setupIDT(0x0f, (vaddr)&isr_wrapper_0x0f);
   setupIDT(0x10, (vaddr)&isr_wrapper_0x10);
   setupIDT(0x11, (vaddr)&isr_wrapper_0x11);
@@ -918,6 +1066,27 @@ extern "C" void exception_handler_errcode_0x0d(mword* isrFrame, mword ec) {
   Reboot(*isrFrame);
 }
 
+// rcx, rax, and hardware frame copied to interrupted stack, cf. isr_wrapper.S
+static const size_t pageFaultFrame = 8 * sizeof(mword);
+
+// first stage, on page fault stack: commit lazy kernel stack page, or make
+// sure that the frame can be moved to the interrupted stack -> regular
+// handler runs there and can fault again (nested page faults)
+extern "C" mword exception_handler_stack_0x0e(mword* isrFrame, mword ec) {
+  if (*(isrFrame+1) != Machine::kernCS()) return 0; // user: kernel stack top
+  LocalProcessor::lockFake();
+  vaddr da = CPU::readCR2();
+  vaddr sp = align_down(vaddr(*(isrFrame+3)), vaddr(16)) - pageFaultFrame;
+  bool grown = kernelAS.stackfault(da);
+  if (!grown) kernelAS.stackfault(sp);
+  LocalProcessor::unlockFake();
+  if (!grown && (kernelAS.stackoverflow(da) || kernelAS.stackoverflow(sp))) {
+    KERR::outl("KERNEL STACK OVERFLOW @ ", FmtHex(*isrFrame), " / data: ", FmtHex(da), " / stack: ", FmtHex(*(isrFrame+3)));
+    Reboot(*isrFrame);
+  }
+  return grown;
+}
+
 extern "C" void exception_handler_errcode_0x0e(mword* isrFrame, mword ec) {
   IsrEntry<false> ie(isrFrame);
   vaddr da = CPU::readCR2();
@@ -981,6 +1150,11 @@ extern "C" void irq_handler_0xe0(mword* isrFrame) { // APIC::WakeIPI
   DBG::outl(DBG::Idle, "got WakeIPI");
 }
 
+extern "C" void irq_handler_0xec(mword* isrFrame) { // APIC::ShootdownIPI
+  IsrEntry<true> ie(isrFrame);
+  BaseAddressSpace::shootdownIPI();
+}
+
 extern "C" void irq_handler_0xed(mword* isrFrame) { // APIC::PreemptIPI
   IsrEntry<true> ie(isrFrame);
   CurrThread()->preempt();
@@ -1008,19 +1182,26 @@ extern "C" void irq_handler_0xf0(mword* isrFrame) { // PIT interrupt
 #endif
 }
 
-extern "C" void irq_handler_0xf1(mword* isrFrame) { // apic timer interrupt
+extern "C" void irq_handler_0xf1(mword* isrFrame) { // APIC::TimerIRQ
   IsrEntry<true> ie(isrFrame);
-  mword i = *(ie.rsp());
-  uint64_t cid_p = LocalProcessor::getIndex();
-	sampleD currentSample;
-  currentSample.address = i;
-  currentSample.cpuID = cid_p;
-  if (ie.fromUser()) {
-  	currentSample.access_type = 1;
-  } else {
-  	currentSample.access_type = 0;
+  SystemProcessor* sp = LocalProcessor::self();
+  sp->countTimerIrq();
+  if (cpu_sample.is_sampling()) {
+    mword i = *(ie.rsp());
+    uint64_t cid_p = LocalProcessor::getIndex();
+    sampleD currentSample;
+    currentSample.address = i;
+    currentSample.cpuID = cid_p;
+    if (ie.fromUser()) {
+      currentSample.access_type = 1;
+    } else {
+      currentSample.access_type = 0;
+    }
+    cpu_sample.put_sample(currentSample);
   }
-	cpu_sample.put_sample(currentSample);
+  sp->getTimerWheel().checkExpiry(Clock::now());
+  Machine::startTimer(true);
+  if (sp->getTimerIrqs() % Machine::getQuantum() == 0) CurrThread()->preempt();
 }
 
 extern "C" void irq_handler_0xf7(mword* isrFrame) { // parallel interrupt, spurious no problem
@@ -1035,9 +1216,6 @@ extern "C" void irq_handler_0xf8(mword* isrFrame) { // RTC interrupt
   KERR::out1(" RTC");
 #endif
   if (!irqMask.empty()) asyncIrqSem.V(); // check interrupts
-  Timeout::checkExpiry(Clock::now());    // check timeout queue
-                                         // simulate APIC timer interrupts
-  Machine::getProcessor(rtc.tick() % Machine::getProcessorCount()).sendIPI(APIC::PreemptIPI);
 }
 
 extern "C" void irq_handler_0xf9(mword* isrFrame) { // spuriously seen
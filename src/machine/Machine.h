@@ -28,6 +28,10 @@ class Machine : public NoObject {
 
   static SystemProcessor* processorTable;
   static mword processorCount;
+  static mword timerTicks;              // APIC timer ticks per millisecond
+  static mword quantum;                 // preemption time slice in ticks
+
+  static void calibrateTimer()                         __section(".boot.text");
 
   static void setupIDT(uint32_t, paddr, uint32_t = 0)  __section(".boot.text");
   static void setupIDTable()                           __section(".boot.text");
@@ -45,6 +49,10 @@ public:
   static void bootMain();
 
   static mword getProcessorCount() { return processorCount; }
+  static mword getQuantum() { return quantum; }
+  static void setQuantum(mword q);
+  static void startTimer(bool update = false);
+  static void idleTimer(mword deadline);
   static SystemProcessor& getProcessor(mword idx) { return processorTable[idx]; }
 
   static void registerIrqSync(mword irq, mword vec);
@@ -97,10 +97,12 @@ static_assert(vaddr(KERNBASE) >= deviceEnd, "KERNBASE < deviceEnd");
 // thread stack constants
 static const size_t stackpl          = 1;
 static const size_t minimumStack     = 1 * pagesize<stackpl>();
-static const size_t defaultStack     = 2 * pagesize<stackpl>();
+static const size_t defaultStack     = 8 * pagesize<stackpl>();
 static const size_t defaultUserStack = 2 * pagesize<stackpl>();
 static const size_t idleStack        = 1 * pagesize<stackpl>();
 static const size_t faultStack       = 1 * pagesize<stackpl>();
 static const size_t stackGuardPage   = 1 * pagesize<stackpl>();
+static const size_t committedStack   = 1 * pagesize<stackpl>(); // top of lazy kernel stack
+static const size_t lazyStack        = defaultStack - committedStack; // max lazy part
 
 #endif /* _Memory_h_ */
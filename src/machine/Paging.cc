@@ -25,9 +25,12 @@ const BitString<uint64_t, 5, 1> Paging::A;
 const BitString<uint64_t, 6, 1> Paging::D;
 const BitString<uint64_t, 7, 1> Paging::PS;
 const BitString<uint64_t, 8, 1> Paging::G;
+const BitString<uint64_t, 9, 1> Paging::COW;
 const BitString<uint64_t,12,40> Paging::ADDR;
 const BitString<uint64_t,63, 1> Paging::XD;
 
+paddr Paging::zeroPage = topaddr;
+
 ostream& operator<<(ostream& os, const Paging::PageEntryFmt& f) {
   if (f.t & Paging::P())    os << " P";
   if (f.t & Paging::RW())   os << " RW";
@@ -38,6 +41,7 @@ ostream& operator<<(ostream& os, const Paging::PageEntryFmt& f) {
   if (f.t & Paging::D())    os << " D";
   if (f.t & Paging::PS())   os << " PS";
   if (f.t & Paging::G())    os << " G";
+  if (f.t & Paging::COW())  os << " COW";
   os << " ADDR:" << FmtHex(f.t & Paging::ADDR());
   if (f.t & Paging::XD())   os << " XD";
   return os;
@@ -19,6 +19,7 @@
 
 #include "generic/RegionSet.h"
 #include "kernel/FrameManager.h"
+#include "kernel/KernelHeap.h"
 #include "kernel/Output.h"
 #include "machine/asmshare.h"
 #include "machine/CPU.h"
@@ -47,6 +48,7 @@ class Paging {
   static const BitString<uint64_t, 6, 1> D;      // dirty
   static const BitString<uint64_t, 7, 1> PS;     // page size (vs. table)
   static const BitString<uint64_t, 8, 1> G;      // no CR3-based TLB flush
+  static const BitString<uint64_t, 9, 1> COW;    // copy-on-write (software)
   static const BitString<uint64_t,12, 1> PAT;    // memory typing (caching)
   static const BitString<uint64_t,12,40> ADDR;   // physical address
   static const BitString<uint64_t,63, 1> XD;     // execute-disable
@@ -172,6 +174,65 @@ private:
 protected:
   static const paddr guardPage = topaddr & ADDR();
   static const paddr lazyPage  = guardPage - pagesize<1>();
+  static paddr zeroPage;                         // shared, read-only
+
+  static bool useZeroPage(uint64_t type, uint64_t pff) {
+#if TESTING_NEVER_ZEROPAGE
+    return false;
+#else
+    return zeroPage != topaddr && (type & RW()) && !(pff & PageFaultFlags::WR());
+#endif
+  }
+
+  // lazy entry -> given frame without allocation or output: kernel stack
+  // growth on page fault stack (cf. KernelAddressSpace::stackfault)
+  static bool mapLazy( vaddr vma, paddr pma, uint64_t type ) {
+    return mapInternal<smallpl,false>(align_down(vma, smallps), pma | type, lazyPage);
+  }
+
+  // frame shared between address spaces: read-only, or copy-on-write
+  static uint64_t sharedType( uint64_t type ) {
+    return RW.get(type) ? (type & ~RW()) | COW() : type;
+  }
+
+  // write to frame through per-CPU clone window; zero fill, if 'src' is 0
+  static void writeFrame( paddr pma, vaddr src, size_t size = pagetableps ) {
+    LocalProcessor::lock();
+    vaddr cloneAddr = cloneBase + pagetableps * LocalProcessor::getIndex();
+    mapPage<pagetablepl>(cloneAddr, pma, Data | Kernel);
+    if (src) memcpy((ptr_t)cloneAddr, (ptr_t)src, size);
+    else memset((ptr_t)cloneAddr, 0, size);
+    unmap<pagetablepl,true>(cloneAddr);
+    LocalProcessor::unlock();
+  }
+
+  // allocated frames of an unmapped range, released after TLB invalidation
+  // entry: physical address | log2(page size)
+  struct FrameBatch {
+    paddr* frames;
+    size_t count;
+    size_t capacity;
+    FrameBatch() : frames(nullptr), count(0), capacity(0) {}
+    void add(paddr pma, size_t ps) {
+      if (count == capacity) {
+        size_t nc = capacity ? 2 * capacity : 16;
+        paddr* nf = kmalloc<paddr>(nc);
+        if (count) memcpy(nf, frames, count * sizeof(paddr));
+        kfree<paddr>(frames, capacity);
+        frames = nf;
+        capacity = nc;
+      }
+      frames[count] = pma | floorlog2(ps);
+      count += 1;
+    }
+    void release(FrameManager& fm) {
+      for (size_t i = 0; i < count; i += 1) {
+        fm.release(align_down(frames[i], smallps), size_t(1) << (frames[i] & (smallps - 1)));
+      }
+      kfree<paddr>(frames, capacity);
+    }
+  };
+
 
   template <unsigned int N>
   static bool mapToGuard( vaddr vma ) {
@@ -200,17 +261,135 @@ protected:
     return checkMapping<N>(vma, pff);
   }
 
+  // replace leaf entry (lazy, guard, or page) by page table of equivalent
+  // smaller entries: filled via per-CPU clone window before installation
+  // -> concurrent faults only ever see valid entries
+  template <unsigned int N>
+  static void splitLeaf( vaddr vma, PageEntry pe, FrameManager& fm ) {
+    static_assert( N > 1 && N < pagelevels, "page level template violation" );
+    paddr pt = fm.allocFrame<pagetablepl>();
+    LocalProcessor::lock();
+    vaddr cloneAddr = cloneBase + pagetableps * LocalProcessor::getIndex();
+    mapPage<pagetablepl>(cloneAddr, pt, Data | Kernel);
+    for (mword i = 0; i < ptentries; i += 1) {
+      ((PageEntry*)cloneAddr)[i] = P.get(pe) ? ((pe & ~PS()) + i * pagesize<N-1>()) | xPS<N-1>() : pe;
+    }
+    unmap<pagetablepl,true>(cloneAddr);
+    LocalProcessor::unlock();
+    vma = align_down(vma, pagesize<N>());
+    bool success = mapInternal<N,false>(vma, pt | PageTable | User, pe);
+    if (!success) fm.release(pt, pagetableps);
+    DBG::outl(DBG::Paging, "Paging::splitLeaf<", N, ">: [", PageVector<N>(vma), "] -> ", success ? FmtHex(pt) : FmtHex(topaddr));
+  }
+
   template <unsigned int N = pagelevels-1>
   static bool mapFromLazy( vaddr vma, uint64_t type, uint64_t pff, FrameManager& fm ) {
     PageEntry pe = getPE<N>(vma);
     if (P.get(pe) && !isPage<N>(pe)) return mapFromLazy<N-1>(vma, type, pff, fm);
-    paddr pma = fm.allocFrame<N>();
+    if (N == smallpl && useZeroPage(type, pff)) {   // read: no frame yet
+      vma = align_down(vma, pagesize<N>());
+      mapInternal<N>(vma, zeroPage | (type & ~RW()) | COW(), lazyPage);
+      return checkMapping<N>(vma, pff);
+    }
+    paddr pma = (N > smallpl) ? fm.tryAllocFrame<N>() : fm.allocFrame<N>();
+    if (pma == topaddr) {                // no large frame -> fall back
+      splitLeaf<N>(vma, lazyPage, fm);
+      pe = getPE<N>(vma);
+      if (P.get(pe) && !isPage<N>(pe)) return mapFromLazy<N-1>(vma, type, pff, fm);
+      return checkMapping<N>(align_down(vma, pagesize<N>()), pff);
+    }
     vma = align_down(vma, pagesize<N>());
     bool success = mapInternal<N>(vma, pma | type | xPS<N>(), lazyPage);
     if (!success) fm.release(pma, pagesize<N>());
     return checkMapping<N>(vma, pff);
   }
 
+  template <unsigned int N = pagelevels>
+  static bool testCOW( vaddr vma ) {
+    static_assert( N > 0 && N <= pagelevels, "page level template violation" );
+    PageEntry pe = getPE<N>(vma);
+    if (!P.get(pe)) return false;
+    if (isPage<N>(pe)) return COW.get(pe);
+    return testCOW<N-1>(vma);
+  }
+
+  // write fault on copy-on-write page: write access, if the frame is not
+  // shared (anymore), otherwise private copy or fresh frame for zero page;
+  // returns replaced frame (reference dropped after TLB invalidation)
+  static paddr breakCOW( vaddr vma, FrameManager& fm ) {
+    vma = align_down(vma, smallps);
+    PageEntry pe = getPE<smallpl>(vma);
+    if (!P.get(pe) || !COW.get(pe)) return topaddr;  // resolved concurrently
+    paddr old = pe & ADDR();
+    PageEntry flags = (pe & ~(ADDR() | COW() | A() | D())) | RW();
+    if (old != zeroPage && fm.exclusive(old)) {
+      mapInternal<smallpl>(vma, old | flags, pe);
+      CPU::InvTLB(vma);
+      return topaddr;
+    }
+    paddr pma = fm.allocFrame<smallpl>();
+    if (old != zeroPage) writeFrame(pma, vma, smallps);
+    if (!mapInternal<smallpl>(vma, pma | flags, pe)) {
+      fm.release(pma, smallps);
+      return topaddr;
+    }
+    CPU::InvTLB(vma);
+    return old;
+  }
+
+  // copy-on-write duplication of the current user half: writable pages
+  // become read-only + COW in both, all frames gain a reference; huge
+  // pages are split first -> reference counts for small frames only
+  template <unsigned int N>
+  static void forkEntries( vaddr start, vaddr end, PageEntry* buf, FrameManager& fm ) {
+    static_assert( N > 0 && N < pagelevels, "page level template violation" );
+    for (vaddr vma = start; vma < end; vma += pagesize<N>()) {
+      PageEntry* ppe = (PageEntry*)accessPE<N>(vma);
+      PageEntry pe = __atomic_load_n(ppe, __ATOMIC_SEQ_CST);
+      mword idx = pageIndex<N>(vma);
+      if (N > smallpl && P.get(pe) && isPage<N>(pe)) {
+        splitLeaf<N>(vma, pe, fm);
+        pe = __atomic_load_n(ppe, __ATOMIC_SEQ_CST);
+      }
+      if (!P.get(pe)) {                           // empty, lazy, or guard
+        buf[idx] = pe;
+      } else if (!isPage<N>(pe)) {
+        buf[idx] = forkTable<N-1>(vma, fm) | PageTable | User;
+      } else {
+        while (RW.get(pe)) {
+          PageEntry npe = (pe & ~RW()) | COW();
+          if (__atomic_compare_exchange_n(ppe, &pe, npe, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) pe = npe;
+        }
+        if ((pe & ADDR()) != zeroPage) fm.share(pe & ADDR());
+        buf[idx] = pe;
+      }
+    }
+  }
+
+  template <unsigned int N>
+  static paddr forkTable( vaddr vma, FrameManager& fm ) {
+    PageEntry* buf = kmalloc<PageEntry>(ptentries);
+    vma = align_down(vma, pagesize<N+1>());
+    forkEntries<N>(vma, vma + pagesize<N+1>(), buf, fm);
+    paddr pt = fm.allocFrame<pagetablepl>();
+    writeFrame(pt, vaddr(buf));
+    kfree<PageEntry>(buf, ptentries);
+    return pt;
+  }
+
+  // user half: lower half of root table
+  static void forkUser( paddr root, FrameManager& fm ) {
+    static const mword userEntries = ptentries / 2;
+    PageEntry* buf = kmalloc<PageEntry>(userEntries);
+    for (mword i = 0; i < userEntries; i += 1) {
+      vaddr vma = i * pagesize<pagelevels>();
+      PageEntry pe = getPE<pagelevels>(vma);
+      buf[i] = P.get(pe) ? forkTable<pagelevels-1>(vma, fm) | PageTable | User : pe;
+    }
+    writeFrame(root, vaddr(buf), userEntries * sizeof(PageEntry));
+    kfree<PageEntry>(buf, userEntries);
+  }
+
   template <unsigned int N = pagelevels>
   static size_t test( vaddr vma, uint64_t status ) {
     static_assert( N > 0 && N <= pagelevels, "page level template violation" );
@@ -232,6 +411,25 @@ protected:
   static size_t testfree( vaddr vma ) { return test(vma, Available); }
   static size_t testused( vaddr vma ) { return test(vma, Guard|Lazy|Mapped); }
 
+  // unmap leaf entry (page, lazy, or guard) at any level: mixed page sizes;
+  // entries only partially covered by [vma,end) are split first
+  template <unsigned int N = pagelevels-1>
+  static paddr unmapLeaf( vaddr vma, vaddr end, size_t& size, FrameManager& fm ) {
+    static_assert( N >= 1 && N < pagelevels, "page level template violation" );
+    PageEntry pe = getPE<N>(vma);
+    if (P.get(pe) && !isPage<N>(pe)) return unmapLeaf<N-1>(vma, end, size, fm);
+    KASSERT1(pe != 0, FmtHex(vma));
+    if (N > smallpl && (!aligned(vma, pagesize<N>()) || vma + pagesize<N>() > end)) {
+      splitLeaf<N>(vma, pe, fm);
+      return unmapLeaf<N>(vma, end, size, fm);
+    }
+    exchangePE<N>(vma, 0);
+    size = pagesize<N>();
+    paddr pma = pe & ADDR();
+    DBG::outl(DBG::Paging, "Paging::unmap<", N, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtHex(pma));
+    return pma;
+  }
+
   template <unsigned int N, bool invTLB=true>
   static paddr unmap( vaddr vma ) {
     static_assert( N >= 1 && N <= pagelevels, "page level template violation" );
@@ -254,7 +452,7 @@ protected:
         if (isPage<N>(pe)) {
           DBG::outl(DBG::Paging, "Paging::clearP<", N, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", PageEntryFmt(pe));
           KASSERT1(N < pagelevels, N);
-          fm.release(pma, pagesize<N>());
+          if (pma != zeroPage) fm.release(pma, pagesize<N>());
         } else {
           clear<N-1>(vma, vma + pagesize<N>(), fm);
           DBG::outl(DBG::Paging, "Paging::clearT<", N-1, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", PageEntryFmt(pe));
@@ -265,10 +463,55 @@ protected:
     }
   }
 
+  // free page tables below level N that are empty after unmapping
+  // [start,end); frames are collected for release after TLB invalidation
+  template <unsigned int N = pagelevels>
+  static size_t reclaim( vaddr start, vaddr end, FrameBatch& fb ) {
+    static_assert( N > 1 && N <= pagelevels, "page level template violation" );
+    size_t count = 0;
+    for (vaddr vma = align_down(start, pagesize<N>()); vma < end; vma += pagesize<N>()) {
+      PageEntry pe = getPE<N>(vma);
+      if (!P.get(pe) || isPage<N>(pe)) continue;
+      count += reclaim<N-1>(max(vma, start), min(vma + pagesize<N>(), end), fb);
+      PageEntry* pt = pageTable<N-1>(vma);
+      mword i = 0;
+      while (i < ptentries && pt[i] == 0) i += 1;
+      if (i < ptentries) continue;
+      DBG::outl(DBG::Paging, "Paging::reclaim<", N-1, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", PageEntryFmt(pe));
+      setPE<N>(vma, 0);
+      fb.add(pe & ADDR(), pagetableps);
+      count += 1;
+    }
+    return count;
+  }
+
+  // number of page tables below level N covering [start,end)
+  template <unsigned int N = pagelevels>
+  static size_t countTables( vaddr start, vaddr end ) {
+    static_assert( N > 1 && N <= pagelevels, "page level template violation" );
+    size_t count = 0;
+    for (vaddr vma = align_down(start, pagesize<N>()); vma < end; vma += pagesize<N>()) {
+      PageEntry pe = getPE<N>(vma);
+      if (!P.get(pe) || isPage<N>(pe)) continue;
+      count += 1 + countTables<N-1>(max(vma, start), min(vma + pagesize<N>(), end));
+    }
+    return count;
+  }
+
   static void installPagetable(paddr pt) {
     CPU::writeCR3(pt);
   }
 
+  // with PCID: keep TLB entries tagged with 'pcid', unless 'flush'
+  static void installPagetable(paddr pt, mword pcid, bool flush) {
+    static const mword noFlush = mword(1) << 63;
+    CPU::writeCR3(pt | pcid | (flush ? 0 : noFlush));
+  }
+
+  static paddr currentPagetable() {
+    return CPU::readCR3() & ADDR();      // strip PCID
+  }
+
   static inline void clone(paddr pt);
 
   Paging() = default;
@@ -278,7 +521,12 @@ protected:
 public:
   static inline paddr bootstrap(vaddr kernelBase, vaddr kernelData, vaddr kernelEnd, RegionSet<Region<paddr>>& mem, _friend<Machine>);
   static inline vaddr bootstrap2(RegionSet<Region<paddr>>& mem, size_t maxHeap, size_t startHeap, _friend<Machine>);
-  static inline void  bootstrap3(mword coreCount, _friend<Machine>);
+  static inline void  bootstrap3(mword windowCount, _friend<Machine>);
+
+  static void initZeroPage(FrameManager& fm, _friend<Machine>) {
+    zeroPage = fm.allocFrame<smallpl>();
+    writeFrame(zeroPage, 0, smallps);
+  }
 
   template <unsigned int N>
   static bool mapPage( vaddr vma, paddr pma, uint64_t type, _friend<Machine> ) {
@@ -325,9 +573,15 @@ template<> inline ostream& operator<<(ostream& os, const Paging::PageVector<page
 
 // corner cases that need dummy template instantiations
 template<> inline bool   Paging::mapFromLazy<0>(vaddr, uint64_t, uint64_t, FrameManager&) { KABORT0(); return false; }
+template<> inline void   Paging::splitLeaf<1>(vaddr, PageEntry, FrameManager&) { KABORT0(); }
+template<> inline paddr  Paging::unmapLeaf<0>(vaddr, vaddr, size_t&, FrameManager&) { KABORT0(); return 0; }
 template<> inline size_t Paging::test<0>(vaddr, uint64_t ) { KABORT0(); return 0; }
+template<> inline bool   Paging::testCOW<0>(vaddr) { KABORT0(); return false; }
+template<> inline paddr  Paging::forkTable<0>(vaddr, FrameManager&) { KABORT0(); return 0; }
 template<> inline void   Paging::clear<0>(vaddr, vaddr, FrameManager&) { KABORT0(); }
 template<> inline paddr  Paging::vtop<0>(vaddr) { KABORT0(); return 0; }
+template<> inline size_t Paging::reclaim<1>(vaddr, vaddr, FrameBatch&) { return 0; }
+template<> inline size_t Paging::countTables<1>(vaddr, vaddr) { return 0; }
 
 // must be defined after Paging::accessPE_Helper<0> specialization
 inline constexpr vaddr Paging::start() {
@@ -441,10 +695,10 @@ inline vaddr Paging::bootstrap2(RegionSet<Region<paddr>>& mem, size_t maxHeap, s
   return bottom;
 }
 
-inline void Paging::bootstrap3(mword coreCount, _friend<Machine>) {
-  // PD setup for zeroing for more than 'ptentries' cores
+inline void Paging::bootstrap3(mword windowCount, _friend<Machine>) {
+  // PD setup for more than 'ptentries' zeroing windows
   vaddr addr = zeroBase;
-  for (mword count = ptentries; count < coreCount; count += ptentries) {
+  for (mword count = ptentries; count < windowCount; count += ptentries) {
     addr += pagesize<kernelpl+1>();
     paddr pd = CurrFM().allocFrame<pagetablepl>();
     setPE<kernelpl+1>(addr, pd | PageTable);
@@ -39,6 +39,7 @@ void Processor::init(paddr pml4, bool output, InterruptDescriptor* idtTable, siz
   if (CPUID::ARAT())           DBG::out1(dl, " ARAT");
   if (CPUID::FSGSBASE())       DBG::out1(dl, " FSGSBASE");
   if (CPUID::Page1G())         DBG::out1(dl, " Page1G");
+  if (CPUID::PCID())           DBG::out1(dl, " PCID");
   DBG::outl(dl);
 
   MSR::enableNX();                                   // enable NX paging bit
@@ -49,6 +50,7 @@ void Processor::init(paddr pml4, bool output, InterruptDescriptor* idtTable, siz
   // CPU::writeCR0(CPU::readCR0() | CPU::MP());         // enable monitor coprocessor
   CPU::writeCR0(CPU::readCR0() & ~(CPU::EM()));      // disable x87 emulation
   if (pml4 != topaddr) CPU::writeCR3(pml4);          // install page tables
+  CPUID::enablePCID();                               // tagged TLB, if available
 
   Context::install();
 
@@ -64,7 +66,7 @@ void Processor::init(paddr pml4, bool output, InterruptDescriptor* idtTable, siz
   loadIDT(idtTable, idtSize);  // install interrupt table
 }
 
-void Processor::startup(BaseScheduler& sched, funcvoid0_t func) {
+void Processor::startup(Scheduler& sched, funcvoid0_t func) {
   MSR::enableSYSCALL();                               // enable syscall/sysret
   // top  16 bits: index 2 = userDS - 1 = userCS - 2; * 8 (selector size) + 3 (CPL); userDS follows this index, followed by userCS
   // next 16 bits: index 1 = kernCS     = kernDS - 1; * 8 (selector size) + 0 (CPL); kernCS is at   this index, followed by kernDS
@@ -83,9 +85,12 @@ void Processor::startup(BaseScheduler& sched, funcvoid0_t func) {
   tss.ist[stfIST-1] = fstack;
   DBG::outl(DBG::Basic, "Fault Stack for ", index, " at ", FmtHex(fstack));
 
+  // separate page fault stack: lazy kernel stacks, cf. isr_wrapper_0x0e
+  tss.ist[pfIST-1] = kernelAS.allocStack(faultStack) + faultStack;
+
   Thread* idleThread = Thread::create(idleStack);
   idleThread->setScheduler(sched)->setAffinity(true)->setPriority(idlePriority);
-  idleThread->setup((ptr_t)Runtime::idleLoop);
+  idleThread->setup((ptr_t)Runtime::idleLoop, &sched);
   idleThread->resume();
   currThread = Thread::create(defaultStack);
   currThread->setScheduler(sched)->setAffinity(true)->direct((ptr_t)func);
@@ -26,7 +26,7 @@
 
 class Thread;
 class FrameManager;
-class BaseScheduler;
+class Scheduler;
 struct Runtime;
 
 static APIC*   MappedAPIC()   { return   (APIC*)apicAddr; }
@@ -34,8 +34,27 @@ static IOAPIC* MappedIOAPIC() { return (IOAPIC*)ioApicAddr; }
 
 class SystemProcessor;
 
+// queue node for MCSSpinLock, per-CPU pool in Context
+struct MCSNode {
+  MCSNode* volatile next;
+  volatile bool wait;
+};
+
+#if TESTING_LOCK_PROFILE
+// per-CPU lock statistics, keyed by call site (cf. kernel/LockProfile.h)
+struct LockSite {
+  mword site;                       // code address of acquire
+  mword lock;                       // last lock acquired here
+  mword count;
+  mword contended;
+  mword wait;                       // TSC cycles spent spinning/blocking
+  mword hold;                       // TSC cycles held
+};
+#endif
+
 class Context {
   friend class LocalProcessor;      // member offsets for %gs-based access
+  friend class LockProfile;         // merge per-CPU lock statistics
 protected:
   mword            index;
   mword            apicID;
@@ -46,8 +65,22 @@ protected:
   mword            epoch;
   SystemProcessor* sproc;
   TaskStateSegment tss;
+  static const mword mcsNodeCount = 8;    // max nesting of queued spinlocks
+  Context*         self;
+  mword            mcsUsed;
+  MCSNode          mcsNode[mcsNodeCount];
+#if TESTING_LOCK_PROFILE
+  static const mword lockSiteBits = 8;
+  LockSite         lockSite[1 << lockSiteBits];
+  mword            lockSiteDropped; // samples lost: table full
+#endif
   Context(SystemProcessor* s) : index(0), apicID(0), systemID(0), lockCount(1),
-    currThread(nullptr), currFM(nullptr), epoch(0), sproc(s) {}
+    currThread(nullptr), currFM(nullptr), epoch(0), sproc(s), self(this), mcsUsed(0) {
+#if TESTING_LOCK_PROFILE
+    for (LockSite& ls : lockSite) ls = { 0, 0, 0, 0, 0, 0 };
+    lockSiteDropped = 0;
+#endif
+  }
   void install() {
     MSR::write(MSR::GS_BASE, mword(this)); // store 'this' in gs
     MSR::write(MSR::KERNEL_GS_BASE, 0);    // later: store user value in shadow gs
@@ -62,6 +95,7 @@ class Processor : public Context {
   static const unsigned int nmiIST = 1;
   static const unsigned int dbfIST = 2;
   static const unsigned int stfIST = 3;
+  static const unsigned int pfIST  = 4;
 
   // layout for syscall/sysret, because of (strange) rules for SYSCALL_LSTAR
   // SYSCALL_LSTAR essentially forces userCS = userDS + 1
@@ -91,14 +125,17 @@ class Processor : public Context {
   void init(paddr, bool, InterruptDescriptor*, size_t)  __section(".boot.text");
 
 protected:
-  void startup(BaseScheduler& sched, funcvoid0_t func)  __section(".boot.text");
+  void startup(Scheduler& sched, funcvoid0_t func)      __section(".boot.text");
 
 public:
   Processor(SystemProcessor* s) : Context(s) {}
   mword getIndex() const { return index; }
+  FrameManager& getFrameManager() const { return *currFM; }
+  Thread* getRunningThread() const { return __atomic_load_n(&currThread, __ATOMIC_RELAXED); }
   void sendIPI(uint8_t vec) { MappedAPIC()->sendIPI(apicID, vec); }
   void sendWakeIPI() { sendIPI(APIC::WakeIPI); }
   void sendPreemptIPI() { sendIPI(APIC::PreemptIPI); }
+  void sendShootdownIPI() { sendIPI(APIC::ShootdownIPI); }
 }	 __packed __caligned;
 
 class LocalProcessor {
@@ -123,10 +160,7 @@ class LocalProcessor {
 
 public:
   static void initInterrupts(bool irqs);
-  
-	static void setApicTimer() { MappedAPIC()->timer_perf(); }
-	static void clearApicTimer() { MappedAPIC()->timer_perf_clear(); }
-	
+
 	static mword getIndex() {
     return get<mword, offsetof(Context, index)>();
   }
@@ -165,6 +199,11 @@ public:
     // no races here (interrupts disabled)
     if slowpath(getLockCount() == 0) enableInterrupts();
   }
+  static void unlockHalt() {            // sti shadow: no wakeup lost before hlt
+    KASSERT1(checkLock() == 1, getLockCount());
+    decLockCount();
+    asm volatile("sti; hlt" ::: "memory");
+  }
 
   static Thread* getCurrThread(_friend<Runtime>) {
     return get<Thread*, offsetof(Context, currThread)>();
@@ -185,6 +224,40 @@ public:
     asm volatile("addq $1, %%gs:%c0" :: "i"(offsetof(Context, epoch)) : "cc");
   }
 
+  // interrupts disabled -> no concurrent access to per-CPU node pool
+  static MCSNode* allocMCSNode() {
+    KASSERT0(!CPU::interruptsEnabled());
+    Context* c = get<Context*, offsetof(Context, self)>();
+    KASSERT1(~c->mcsUsed & ((1ul << Context::mcsNodeCount) - 1), FmtHex(c->mcsUsed));
+    mword idx = __builtin_ctzl(~c->mcsUsed);
+    c->mcsUsed |= 1ul << idx;
+    return &c->mcsNode[idx];
+  }
+  static void freeMCSNode(MCSNode* n) {
+    KASSERT0(!CPU::interruptsEnabled());
+    Context* c = get<Context*, offsetof(Context, self)>();
+    mword idx = n - c->mcsNode;
+    KASSERT1(idx < Context::mcsNodeCount, FmtHex(n));
+    c->mcsUsed &= ~(1ul << idx);
+  }
+
+#if TESTING_LOCK_PROFILE
+  // open addressing, linear probing; nullptr (and counted) if table is full
+  static LockSite* getLockSite(mword site) {
+    KASSERT0(!CPU::interruptsEnabled());
+    Context* c = get<Context*, offsetof(Context, self)>();
+    const mword mask = (1 << Context::lockSiteBits) - 1;
+    mword idx = (site * 0x9E3779B97F4A7C15ul) >> (64 - Context::lockSiteBits);
+    for (mword i = 0; i <= mask; i += 1) {
+      LockSite& ls = c->lockSite[(idx + i) & mask];
+      if (ls.site == site) return &ls;
+      if (ls.site == 0) { ls.site = site; return &ls; }
+    }
+    c->lockSiteDropped += 1;
+    return nullptr;
+  }
+#endif
+
   static SystemProcessor* self() {
     KASSERT0(checkLock());
     return get<SystemProcessor*, offsetof(Context, sproc)>();
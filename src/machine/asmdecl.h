@@ -28,6 +28,7 @@ extern "C" void loadTR(uint16_t selector);
 // syscall_wrapper.S
 extern "C" void syscall_wrapper(void);
 extern "C" void startUserCode(ptr_t arg1, ptr_t arg2, vaddr ksp, funcvoid2_t invoke, vaddr usp) __noreturn;
+extern "C" void startForkedCode(vaddr ksp, vaddr rip, vaddr usp, mword rflags) __noreturn;
 
 // isr_wrapper.S
 extern "C" void isr_wrapper_0x00(void);
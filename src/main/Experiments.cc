@@ -14,12 +14,21 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
+#include "runtime/BlockingSync.h"
 #include "runtime/Scheduler.h"
 #include "runtime/Thread.h"
+#include "kernel/AddressSpace.h"
+#include "kernel/Clock.h"
+#include "kernel/FrameManager.h"
+#include "kernel/KernelHeap.h"
+#include "kernel/Process.h"
+#include "kernel/StackPool.h"
 #include "kernel/Output.h"
 #include "machine/APIC.h"
 #include "machine/Machine.h"
 
+#include <algorithm>
+
 extern void (*tipiHandler)(void);
 
 // simple IPI measurements, TODO: should do IPI ping pong
@@ -69,7 +78,648 @@ static void run() {
 
 } // namespace IPI_Experiment
 
+// many short threads started on one core: peer push vs. idle work stealing
+// vs. shared group scheduler across all cores
+namespace Scheduler_Experiment {
+
+static const mword threadCount = 256;
+static const mword workLoops = 20000;
+
+static mword startTSC[threadCount];
+static mword latency[threadCount];
+static mword coreCount[64];
+static Semaphore doneSem;
+static GroupScheduler group;
+
+static void worker(ptr_t x) {
+  mword idx = mword(x);
+  latency[idx] = CPU::readTSC() - startTSC[idx];
+  for (int i = 0; i < 4; i += 1) {
+    for (mword j = 0; j < workLoops; j += 1) asm volatile("" ::: "memory");
+    CurrThread()->yield();                // peer scheme migrates on yield
+  }
+  __atomic_add_fetch(&coreCount[LocalProcessor::getIndex() % 64], 1, __ATOMIC_RELAXED);
+  doneSem.V();
+}
+
+static void setGroup(bool grouped) {
+  for (mword c = 0; c < Machine::getProcessorCount(); c += 1) {
+    Machine::getProcessor(c).getScheduler().setGroup(grouped ? &group : nullptr);
+  }
+}
+
+static void runOnce(const char* mode, bool stealing, bool grouped) {
+  BaseScheduler::stealing = stealing;
+  for (mword c = 0; c < 64; c += 1) coreCount[c] = 0;
+  setGroup(grouped);
+  mword tscStart = CPU::readTSC();
+  for (mword i = 0; i < threadCount; i += 1) {
+    Thread* t = Thread::create();
+    if (grouped) t->setScheduler(group)->setAffinity(true);
+    startTSC[i] = CPU::readTSC();
+    t->start((ptr_t)worker, (ptr_t)i);
+  }
+  for (mword i = 0; i < threadCount; i += 1) doneSem.P();
+  mword tscTotal = CPU::readTSC() - tscStart;
+  sort(latency, latency + threadCount);
+  KOUT::outl("scheduler experiment (", mode, "): ",
+    threadCount, " threads in ", tscTotal, " cycles, start latency p50/p99/max: ",
+    latency[threadCount / 2], '/', latency[threadCount * 99 / 100], '/', latency[threadCount - 1]);
+  KOUT::out1(" cores:");
+  for (mword c = 0; c < min(Machine::getProcessorCount(), mword(64)); c += 1) KOUT::out1(' ', coreCount[c]);
+  KOUT::outl();
+}
+
+// stress: threads pass tokens around a ring of semaphores, so they are
+// suspended on one core and resumed from another, while idle cores steal
+static const mword ringSize = 32;
+static const mword ringTokens = 8;
+static const mword ringDuration = 1000;     // ticks
+static Semaphore ring[ringSize];
+static mword ringCount[ringSize];
+static volatile bool ringStop;
+
+static void ringWorker(ptr_t x) {
+  mword idx = mword(x);
+  while (!ringStop) {
+    ring[idx].P();
+    ring[(idx + 1) % ringSize].V();
+    ringCount[idx] += 1;
+  }
+  __atomic_add_fetch(&coreCount[LocalProcessor::getIndex() % 64], 1, __ATOMIC_RELAXED);
+  doneSem.V();
+}
+
+static void stress(const char* mode, bool stealing, bool grouped) {
+  BaseScheduler::stealing = stealing;
+  for (mword c = 0; c < 64; c += 1) coreCount[c] = 0;
+  setGroup(grouped);
+  ringStop = false;
+  for (mword i = 0; i < ringSize; i += 1) {
+    ringCount[i] = 0;
+    Thread* t = Thread::create();
+    if (grouped) t->setScheduler(group)->setAffinity(true);
+    t->start((ptr_t)ringWorker, (ptr_t)i);
+  }
+  for (mword i = 0; i < ringTokens; i += 1) ring[i * ringSize / ringTokens].V();
+  Timeout::sleep(Clock::now() + ringDuration);
+  ringStop = true;
+  for (mword i = 0; i < ringSize; i += 1) ring[i].V();  // release blocked workers
+  for (mword i = 0; i < ringSize; i += 1) doneSem.P();
+  mword total = 0;
+  for (mword i = 0; i < ringSize; i += 1) total += ringCount[i];
+  KOUT::out1("scheduler stress (", mode, "): ", total, " hand-offs, cores:");
+  for (mword c = 0; c < min(Machine::getProcessorCount(), mword(64)); c += 1) KOUT::out1(' ', coreCount[c]);
+  KOUT::outl();
+}
+
+static void run() {
+  KOUT::outl("scheduler experiment running...");
+  bool save = BaseScheduler::stealing;
+  runOnce("peer", false, false);
+  runOnce("stealing", true, false);
+  runOnce("group", false, true);
+  stress("stealing", true, false);
+  stress("group", false, true);
+  setGroup(false);
+  BaseScheduler::stealing = save;
+}
+
+} // namespace Scheduler_Experiment
+
+// CPU-bound threads, two per core: time slice should not depend on core count
+namespace Preemption_Experiment {
+
+static const mword maxThreads = 32;
+static const mword duration = 1000; // ms
+
+static volatile bool done;
+static mword loopCount[maxThreads];
+static Semaphore doneSem;
+
+static void spinner(ptr_t x) {
+  mword idx = mword(x);
+  while (!done) loopCount[idx] += 1;
+  doneSem.V();
+}
+
+static void runOnce(mword cores) {
+  mword threads = 2 * cores;
+  done = false;
+  for (mword i = 0; i < threads; i += 1) {
+    loopCount[i] = 0;
+    Thread* t = Thread::create();
+    t->setScheduler(Machine::getProcessor(i % cores).getScheduler())->setAffinity(true);
+    t->start((ptr_t)spinner, (ptr_t)i);
+  }
+  Timeout::sleep(Clock::now() + duration);
+  done = true;
+  for (mword i = 0; i < threads; i += 1) doneSem.P();
+  mword minCount = limit<mword>(), maxCount = 0;
+  for (mword i = 0; i < threads; i += 1) {
+    minCount = min(minCount, loopCount[i]);
+    maxCount = max(maxCount, loopCount[i]);
+  }
+  KOUT::outl("preemption experiment (", cores, " cores, quantum ", Machine::getQuantum(),
+    " ticks): min/max loops: ", minCount, '/', maxCount, " fairness: ", minCount * 100 / max(maxCount, mword(1)), '%');
+}
+
+// timer interrupts per core while (mostly) idle -> tickless idle
+static void idleIrqs() {
+  static mword irqs[64];
+  mword cores = min(Machine::getProcessorCount(), mword(64));
+  for (mword c = 0; c < cores; c += 1) irqs[c] = Machine::getProcessor(c).getTimerIrqs();
+  Timeout::sleep(Clock::now() + duration);
+  KOUT::out1("timer irqs per core in ", duration, "ms idle:");
+  for (mword c = 0; c < cores; c += 1) KOUT::out1(' ', Machine::getProcessor(c).getTimerIrqs() - irqs[c]);
+  KOUT::outl();
+}
+
+static void run() {
+  KOUT::outl("preemption experiment running...");
+  idleIrqs();
+  for (mword cores = 1; cores <= 16; cores *= 4) {
+    if (cores <= Machine::getProcessorCount()) runOnce(cores);
+  }
+}
+
+} // namespace Preemption_Experiment
+
+// many concurrent timed waits that mostly expire -> timer wheel insert/expiry
+namespace Timeout_Experiment {
+
+static const mword threadCount = 64;
+static const mword rounds = 100;
+
+static Semaphore never;                  // nobody calls V() -> all waits time out
+static mword cycles[threadCount];
+static mword late[threadCount];
+static Semaphore doneSem;
+
+static void waiter(ptr_t x) {
+  mword idx = mword(x);
+  cycles[idx] = late[idx] = 0;
+  for (mword r = 0; r < rounds; r += 1) {
+    mword deadline = Clock::now() + 1 + (idx + r) % 8;
+    mword tsc = CPU::readTSC();
+    never.tryP(deadline);
+    cycles[idx] += CPU::readTSC() - tsc;
+    late[idx] += Clock::now() - deadline;
+  }
+  doneSem.V();
+}
+
+static void run() {
+  KOUT::outl("timeout experiment running...");
+  mword cores = Machine::getProcessorCount();
+  for (mword i = 0; i < threadCount; i += 1) {
+    Thread* t = Thread::create();
+    t->setScheduler(Machine::getProcessor(i % cores).getScheduler())->setAffinity(true);
+    t->start((ptr_t)waiter, (ptr_t)i);
+  }
+  for (mword i = 0; i < threadCount; i += 1) doneSem.P();
+  mword totalCycles = 0, totalLate = 0, maxLate = 0;
+  for (mword i = 0; i < threadCount; i += 1) {
+    totalCycles += cycles[i];
+    totalLate += late[i];
+    maxLate = max(maxLate, late[i]);
+  }
+  KOUT::outl("timeout experiment: ", threadCount * rounds, " timed waits, avg cycles: ",
+    totalCycles / (threadCount * rounds), " avg/max lateness per thread: ",
+    totalLate / threadCount, '/', maxLate, "ms");
+}
+
+} // namespace Timeout_Experiment
+
+// sleep accuracy of TSC-based sleepNanos: log2 histogram of lateness (ns)
+namespace Clock_Experiment {
+
+static const mword rounds = 100;
+static const mword buckets = 24;
+
+static void histogram(mword ns) {
+  mword hist[buckets] = {};
+  for (mword r = 0; r < rounds; r += 1) {
+    mword deadline = Clock::nanos() + ns;
+    Timeout::sleepNanos(deadline);
+    mword late = Clock::nanos() - deadline;
+    mword b = late ? min(mword(floorlog2(late)), buckets - 1) : 0;
+    hist[b] += 1;
+  }
+  KOUT::out1("sleep ", ns, "ns, lateness log2(ns) histogram:");
+  for (mword b = 0; b < buckets; b += 1) if (hist[b]) KOUT::out1(' ', b, ':', hist[b]);
+  KOUT::outl();
+}
+
+static void run() {
+  KOUT::outl("clock experiment running...");
+  for (mword ns = 1000; ns <= 10000000; ns *= 10) histogram(ns);
+}
+
+} // namespace Clock_Experiment
+
+// raw spinlock throughput & fairness with one pinned thread per core
+namespace SpinLock_Experiment {
+
+static const mword maxCores = 64;
+static const mword duration = 100000000; // ns
+
+static mword counts[maxCores];
+static volatile mword shared;
+static Semaphore doneSem;
+
+template<typename Lock>
+static void worker(ptr_t x) {
+  static Lock lock;
+  mword idx = mword(x);
+  mword end = Clock::nanos() + duration;
+  while (Clock::nanos() < end) {
+    LocalProcessor::lock();
+    lock.acquire();
+    shared += 1;
+    lock.release();
+    LocalProcessor::unlock();
+    counts[idx] += 1;
+  }
+  doneSem.V();
+}
+
+template<typename Lock>
+static void runOnce(const char* name, mword cores) {
+  for (mword i = 0; i < cores; i += 1) {
+    counts[i] = 0;
+    Thread* t = Thread::create();
+    t->setScheduler(Machine::getProcessor(i).getScheduler())->setAffinity(true);
+    t->start((ptr_t)worker<Lock>, (ptr_t)i);
+  }
+  for (mword i = 0; i < cores; i += 1) doneSem.P();
+  mword total = 0, minCount = limit<mword>(), maxCount = 0;
+  for (mword i = 0; i < cores; i += 1) {
+    total += counts[i];
+    minCount = min(minCount, counts[i]);
+    maxCount = max(maxCount, counts[i]);
+  }
+  KOUT::outl("spinlock experiment (", name, ", ", cores, " cores): ", total * 1000000000 / duration,
+    " acq/s, fairness: ", minCount * 100 / max(maxCount, mword(1)), '%');
+}
+
+static void run() {
+  KOUT::outl("spinlock experiment running...");
+  mword n = min(Machine::getProcessorCount(), maxCores);
+  for (mword cores = 2; cores <= n; cores *= 2) {
+    runOnce<BinarySpinLock>("binary", cores);
+    runOnce<BackoffSpinLock>("backoff", cores);
+    runOnce<TicketSpinLock>("ticket", cores);
+    runOnce<MCSSpinLock>("mcs", cores);
+  }
+}
+
+} // namespace SpinLock_Experiment
+
+// multi-core kernel heap: sized kmalloc/kfree (magazines) vs. malloc/free
+namespace Heap_Experiment {
+
+static const mword maxCores = 64;
+static const mword batch = 64;
+static const mword duration = 100000000; // ns
+
+static mword counts[maxCores];
+static Semaphore doneSem;
+
+static void worker(ptr_t x, ptr_t m) {
+  mword idx = mword(x);
+  bool sized = m;
+  vaddr obj[batch];
+  mword end = Clock::nanos() + duration;
+  while (Clock::nanos() < end) {
+    for (mword i = 0; i < batch; i += 1) {
+      size_t s = 16 << ((idx + i) % 7);
+      obj[i] = sized ? KernelHeap::alloc(s) : vaddr(malloc(s));
+    }
+    for (mword i = 0; i < batch; i += 1) {
+      size_t s = 16 << ((idx + i) % 7);
+      if (sized) KernelHeap::release(obj[i], s); else free((ptr_t)obj[i]);
+    }
+    counts[idx] += batch;
+  }
+  doneSem.V();
+}
+
+static void runOnce(const char* name, bool sized, mword cores) {
+  for (mword i = 0; i < cores; i += 1) {
+    counts[i] = 0;
+    Thread* t = Thread::create();
+    t->setScheduler(Machine::getProcessor(i).getScheduler())->setAffinity(true);
+    t->start((ptr_t)worker, (ptr_t)i, (ptr_t)sized);
+  }
+  for (mword i = 0; i < cores; i += 1) doneSem.P();
+  mword total = 0;
+  for (mword i = 0; i < cores; i += 1) total += counts[i];
+  KOUT::outl("heap experiment (", name, ", ", cores, " cores): ", total * 1000000000 / duration, " alloc+free/s");
+}
+
+static void run() {
+  KOUT::outl("heap experiment running...");
+  mword n = min(Machine::getProcessorCount(), maxCores);
+  for (mword cores = 1; cores <= n; cores *= 2) {
+    runOnce("malloc", false, cores);
+    runOnce("magazine", true, cores);
+  }
+  for (size_t c = 0; c < KernelHeap::classCount; c += 1) {
+    mword hits, misses;
+    KernelHeap::getStats(c, hits, misses);
+    KOUT::outl("  size class ", KernelHeap::classSize(c), ": ", hits, " hits, ", misses, " misses");
+  }
+}
+
+} // namespace Heap_Experiment
+
+// frame allocation latency with/without pre-zeroed pool
+namespace Zero_Experiment {
+
+static const mword frames = 16384;      // 64MB of small frames
+static paddr addr[frames];
+
+static void report(const char* when) {
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) {
+    FrameManager& fm = FrameManager::getNode(n);
+    KOUT::outl("  node ", n, ' ', when, ": zeroed ", fm.getZeroed() >> 20, "MB, dirty ",
+      fm.getDirty() >> 20, "MB, alloc stalls ", fm.getStalls());
+  }
+}
+
+static void runOnce(const char* name) {
+  mword start = Clock::nanos();
+  for (mword i = 0; i < frames; i += 1) addr[i] = CurrFM().allocFrame<smallpl>();
+  mword ns = Clock::nanos() - start;
+  for (mword i = 0; i < frames; i += 1) CurrFM().release(addr[i], smallps);
+  KOUT::outl("zero experiment (", name, "): ", ns / frames, " ns/frame");
+  report("after");
+}
+
+static void run() {
+  KOUT::outl("zero experiment running...");
+  report("before");
+  runOnce("cold");
+  runOnce("dirty");                     // immediate reuse of released frames
+  Timeout::sleep(Clock::now() + 500);   // let background zeroing catch up
+  report("rested");
+  runOnce("rested");
+}
+
+} // namespace Zero_Experiment
+
+// address space switch cost: two threads in different address spaces take
+// turns on one core, touching a small working set each turn (cf. PCID)
+namespace PCID_Experiment {
+
+static const mword rounds = 10000;
+static const mword pages = 64;
+
+static mword cycles[2];
+static Semaphore doneSem;
+
+class PingAS : public AddressSpace {
+public:
+  virtual void preThreadSwitch() { if (CurrThread()->finishing()) clean(); }
+  virtual void postThreadDestroy() { delete this; }
+};
+
+class PingThread : public Thread {
+  PingThread(vaddr sb, size_t ss, AddressSpace& as) : Thread(sb, ss, as) {}
+public:
+  static PingThread* create(AddressSpace& as) {
+    vaddr mem = kernelAS.allocStack(defaultStack);
+    vaddr This = mem + defaultStack - sizeof(PingThread);
+    return new (ptr_t(This)) PingThread(mem, defaultStack, as);
+  }
+};
+
+static void worker(ptr_t x) {
+  mword idx = mword(x);
+  AddressSpace& as = CurrThread()->getMemCtx();
+  volatile char* mem = (volatile char*)as.mmap<smallpl>(0, pages * smallps);
+  for (mword p = 0; p < pages; p += 1) mem[p * smallps] = 1;  // fault in
+  CurrThread()->yield();
+  mword start = CPU::readTSC();
+  for (mword r = 0; r < rounds; r += 1) {
+    for (mword p = 0; p < pages; p += 1) mem[p * smallps] += 1;
+    CurrThread()->yield();
+  }
+  cycles[idx] = CPU::readTSC() - start;
+  doneSem.V();
+}
+
+static void run() {
+  KOUT::outl("PCID experiment running (PCID ", CPUID::pcidEnabled() ? "on" : "off", ")...");
+  Scheduler& sched = Machine::getProcessor(Machine::getProcessorCount() - 1).getScheduler();
+  for (mword i = 0; i < 2; i += 1) {
+    PingThread* t = PingThread::create(*knew<PingAS>());
+    t->setScheduler(sched)->setAffinity(true);
+    t->start((ptr_t)worker, (ptr_t)i);
+  }
+  for (mword i = 0; i < 2; i += 1) doneSem.P();
+  KOUT::outl("PCID experiment: ", (cycles[0] + cycles[1]) / (4 * rounds), " cycles/switch (", pages, " pages touched per turn)");
+}
+
+} // namespace PCID_Experiment
+
+// mmap churn: scattered regions, each spanning two page tables; page-table
+// frames must not accumulate after unmapping
+namespace Reclaim_Experiment {
+
+static const mword rounds = 16;
+static const mword regions = 64;
+static const size_t regionSize = pagesize<2>() + pagesize<1>();
+
+static Semaphore doneSem;
+
+static void worker(ptr_t) {
+  AddressSpace& as = CurrThread()->getMemCtx();
+  vaddr mem[regions];
+  size_t before = as.getTableCount();
+  size_t peak = 0;
+  for (mword r = 0; r < rounds; r += 1) {
+    for (mword i = 0; i < regions; i += 1) {
+      mem[i] = as.mmap<smallpl>(0, regionSize);
+      *(volatile char*)(mem[i] + pagesize<2>()) = 1;   // fault in
+    }
+    peak = max(peak, as.getTableCount());
+    for (mword i = 0; i < regions; i += 1) as.munmap<smallpl>(mem[i], regionSize);
+  }
+  KOUT::outl("reclaim experiment: page tables ", before, " before, ", peak, " peak, ",
+    as.getTableCount(), " after, ", as.getTablesReclaimed(), " reclaimed");
+  doneSem.V();
+}
+
+static void run() {
+  KOUT::outl("reclaim experiment running...");
+  PCID_Experiment::PingAS* as = knew<PCID_Experiment::PingAS>();
+  as->setup(usertop - 4 * pagesize<3>());  // unmapped VM reused after invalidation
+  PCID_Experiment::PingThread* t = PCID_Experiment::PingThread::create(*as);
+  t->start((ptr_t)worker);
+  doneSem.P();
+}
+
+} // namespace Reclaim_Experiment
+
+// short-lived threads: create, run empty function, join (via semaphore);
+// stacks and thread objects recycled through per-CPU stack pool
+namespace Thread_Experiment {
+
+static const mword rounds = 1000;
+static const mword batch = 16;
+
+static Semaphore doneSem;
+
+static void worker() {
+  doneSem.V();
+}
+
+static mword runOnce() {
+  mword start = Clock::nanos();
+  for (mword r = 0; r < rounds; r += 1) {
+    for (mword i = 0; i < batch; i += 1) Thread::create()->start((ptr_t)worker);
+    for (mword i = 0; i < batch; i += 1) doneSem.P();
+  }
+  return (Clock::nanos() - start) / (rounds * batch);
+}
+
+static void run() {
+  KOUT::outl("thread experiment running...");
+  mword cold = runOnce();
+  mword warm = runOnce();
+  KOUT::outl("thread experiment: ", cold, " ns/thread cold, ", warm, " ns/thread warm");
+  for (size_t c = 0; c < StackPool::classCount; c += 1) {
+    mword hits, misses;
+    StackPool::getStats(c, hits, misses);
+    KOUT::outl("  stack size ", StackPool::classSize(c), ": ", hits, " hits, ", misses, " misses");
+  }
+}
+
+} // namespace Thread_Experiment
+
+// many mostly idle threads: kernel stacks committed lazily, one thread
+// with deep recursion grows its stack through the page fault handler
+namespace Stack_Experiment {
+
+static const mword threadCount = 4096;
+static const mword depth = 24;          // ~ 12KB of stack
+
+static Thread* threads[threadCount];
+static Semaphore readySem, goSem, doneSem;
+
+static mword recurse(mword n) {
+  volatile char buf[512];
+  buf[0] = n;
+  return n ? recurse(n - 1) + buf[0] : 0;
+}
+
+static void sleeper(ptr_t x) {
+  if (mword(x) == 0) recurse(depth);
+  readySem.V();
+  goSem.P();
+  doneSem.V();
+}
+
+static size_t freeMemory() {
+  size_t f = 0;
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) f += FrameManager::getNode(n).getFree();
+  return f;
+}
+
+static void run() {
+  KOUT::outl("stack experiment running...");
+  size_t before = freeMemory();
+  for (mword i = 0; i < threadCount; i += 1) {
+    threads[i] = Thread::create();
+    threads[i]->start((ptr_t)sleeper, (ptr_t)i);
+  }
+  for (mword i = 0; i < threadCount; i += 1) readySem.P();
+  size_t after = freeMemory();
+  size_t low = limit<size_t>(), high = 0;
+  for (mword i = 1; i < threadCount; i += 1) {
+    low = min(low, threads[i]->getStackUsage());
+    high = max(high, threads[i]->getStackUsage());
+  }
+  KOUT::outl("stack experiment: ", threadCount, " threads, ", (before > after ? before - after : 0) / threadCount,
+    " bytes/thread, stack ", defaultStack, " reserved, ", low, '-', high, " used, recursion ", threads[0]->getStackUsage(), " used");
+  for (mword i = 0; i < threadCount; i += 1) goSem.V();
+  for (mword i = 0; i < threadCount; i += 1) doneSem.P();
+}
+
+} // namespace Stack_Experiment
+
+// process creation: many instances of one binary share its parsed image,
+// text, and read-only data; load latency and memory use per instance
+namespace Spawn_Experiment {
+
+static const mword processes = 256;
+
+static size_t freeMemory() {
+  size_t f = 0;
+  for (mword n = 0; n < FrameManager::getNodeCount(); n += 1) f += FrameManager::getNode(n).getFree();
+  return f;
+}
+
+static void run() {
+  KOUT::outl("spawn experiment running...");
+  auto iter = kernelFS.find("threadtest");
+  if (iter == kernelFS.end()) return;
+  ElfImage* image = ElfImage::get(iter->second);
+  mword loads = image->getLoads();
+  size_t before = freeMemory();
+  mword start = Clock::nanos();
+  for (mword i = 0; i < processes; i += 1) knew<Process>()->exec("threadtest");
+  while (image->getLoads() - loads < processes) Timeout::sleep(Clock::now() + 1);
+  mword loaded = Clock::nanos() - start;
+  size_t after = freeMemory();
+  while (image->getInstances() > 0) Timeout::sleep(Clock::now() + 1);
+  mword finished = Clock::nanos() - start;
+  KOUT::outl("spawn experiment: ", processes, " processes loaded in ", loaded / 1000000, "ms (",
+    loaded / processes / 1000, "us each), finished in ", finished / 1000000, "ms, ",
+    (before > after ? before - after : 0) / processes >> 10, "KB per process");
+}
+
+} // namespace Spawn_Experiment
+
 int Experiments() {
   IPI_Experiment::run();
+#if TESTING_SCHEDULER_TEST
+  Scheduler_Experiment::run();
+#endif
+#if TESTING_PREEMPT_TEST
+  Preemption_Experiment::run();
+#endif
+#if TESTING_TIMEOUT_TEST
+  Timeout_Experiment::run();
+#endif
+#if TESTING_CLOCK_TEST
+  Clock_Experiment::run();
+#endif
+#if TESTING_SPINLOCK_TEST
+  SpinLock_Experiment::run();
+#endif
+#if TESTING_HEAP_TEST
+  Heap_Experiment::run();
+#endif
+#if TESTING_ZERO_TEST
+  Zero_Experiment::run();
+#endif
+#if TESTING_PCID_TEST
+  PCID_Experiment::run();
+#endif
+#if TESTING_RECLAIM_TEST
+  Reclaim_Experiment::run();
+#endif
+#if TESTING_THREAD_TEST
+  Thread_Experiment::run();
+#endif
+#if TESTING_STACK_TEST
+  Stack_Experiment::run();
+#endif
+#if TESTING_SPAWN_TEST
+  Spawn_Experiment::run();
+#endif
   return 0;
 }
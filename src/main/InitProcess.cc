@@ -19,12 +19,30 @@
 int InitProcess() {
   Process* p0 = knew<Process>();
   p0->exec("systest");
-/*
 #if TESTING_MEMORY_HOG
   Process* p1 = knew<Process>();
   p1->exec("memoryhog");
 #endif
-*/
+#if TESTING_FIBER_TEST
+  Process* p8 = knew<Process>();
+  p8->exec("fibertest");
+#endif
+#if TESTING_FUTEX_TEST
+  Process* p9 = knew<Process>();
+  p9->exec("futextest");
+#endif
+#if TESTING_FORK_TEST
+  Process* p7 = knew<Process>();
+  p7->exec("forktest");
+#endif
+#if TESTING_SYNC_TEST
+  Process* p10 = knew<Process>();
+  p10->exec("synctest");
+#endif
+#if TESTING_TLB_TEST
+  Process* p6 = knew<Process>();
+  p6->exec("tlbtest");
+#endif
 #if !TESTING_KEYCODE_LOOP
   Process* p2 = knew<Process>();
   p2->exec("kbloop");
@@ -69,6 +69,55 @@ void MutexTest() {
   KASSERT1(acquireCount == testcount * 10, "wrong number of acquire/release");
 }
 
+// Mutex contention benchmark: short critical sections, spinning vs. blocking
+static const mword benchThreads = 8;
+static const mword benchDuration = 1000; // ms
+static volatile bool benchDone;
+static mword benchShared;
+static mword handoffTSC;
+static Thread* handoffPrev;
+static mword handoffCount;
+static mword handoffCycles;
+
+static void mutexBenchMain(ptr_t) {
+  mword count = 0;
+  while (!benchDone) {
+    mtx.acquire();
+    if (handoffPrev != CurrThread()) {
+      handoffCount += 1;
+      handoffCycles += CPU::readTSC() - handoffTSC;
+    }
+    for (mword i = 0; i < 100; i += 1) benchShared += 1;
+    handoffPrev = CurrThread();
+    handoffTSC = CPU::readTSC();
+    mtx.release();
+    count += 1;
+  }
+  __atomic_add_fetch( &acquireCount, count, __ATOMIC_RELAXED);
+  tsem.V();
+}
+
+static void mutexBench(mword spinCycles) {
+  mword save = Mutex::spinCycles;
+  Mutex::spinCycles = spinCycles;
+  acquireCount = handoffCount = handoffCycles = 0;
+  handoffPrev = nullptr;
+  benchDone = false;
+  for (mword i = 0; i < benchThreads; i += 1) Thread::create()->start((ptr_t)mutexBenchMain);
+  Timeout::sleep(Clock::now() + benchDuration);
+  benchDone = true;
+  for (mword i = 0; i < benchThreads; i += 1) tsem.P();
+  Mutex::spinCycles = save;
+  KOUT::outl("mutex bench (spin ", spinCycles, "): ", acquireCount * 1000 / benchDuration,
+    " acq/s, ", handoffCount, " hand-offs, avg latency: ", handoffCycles / max(handoffCount, mword(1)), " cycles");
+}
+
+void MutexBench() {
+  KOUT::outl("running MutexBench...");
+  mutexBench(0);
+  mutexBench(Mutex::spinCycles);
+}
+
 // Semaphore Test
 static void semaphoreTestMain(ptr_t x) {
   for (int i = 0; i < testcount; i++) {
@@ -154,6 +203,9 @@ void SyncQueueTest() {
 
 int LockTest() {
   MutexTest();
+#if TESTING_MUTEX_BENCH
+  MutexBench();
+#endif
   SemaphoreTest();
   SyncQueueTest();
   KOUT::outl("LockTest done");
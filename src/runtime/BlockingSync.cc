@@ -15,6 +15,67 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "runtime/BlockingSync.h"
+#include "runtime/RuntimeImpl.h"
 
-BasicLock Timeout::lock;
-multimap<mword,Thread*> Timeout::queue;
+mword Mutex::spinCycles = 4000;         // roughly cost of suspend/resume
+
+// spinning is pointless, if owner is descheduled or baton passing is on;
+// the owner is only compared, never dereferenced: it might be gone already
+bool Mutex::spinAcquire() {
+  mword end = CPU::readTSC() + spinCycles;
+  for (;;) {
+    mword o = __atomic_load_n(&owner, __ATOMIC_RELAXED);
+    if (o == 0) {
+      if (tryLock()) return true;
+    } else if ((o & Waiters) || !Runtime::running((Thread*)o, __atomic_load_n(&ownerCPU, __ATOMIC_RELAXED))) return false;
+    if (CPU::readTSC() > end) return false;
+    CPU::Pause();
+  }
+}
+
+void Timeout::checkExpiry(mword now) {
+  Runtime::CurrTimerWheel().checkExpiry(now);
+}
+
+mword Timeout::nextDeadline() {
+  return Runtime::CurrTimerWheel().nextDeadline();
+}
+
+// block on the wheel for whole ticks, then yield/spin for the sub-tick rest
+void Timeout::sleepNanos(mword deadline) {
+  mword tick = Clock::nanosToTick(deadline);
+  if (tick > Clock::now()) sleep(tick);
+  while (Clock::nanos() < deadline) CurrThread()->yield();
+}
+
+// choose and lock the local wheel without preemption in between; the
+// node keeps track of the wheel for cancellation from elsewhere
+void TimeoutInfo::suspend(mword timeout) {
+  Thread* thr = CurrThread();
+  LocalProcessor::lock();
+  TimerWheel& tw = Runtime::CurrTimerWheel();
+  tw.lock.acquire();
+  LocalProcessor::unlock();
+  if (thr->block(this)) {
+    tw.insert(node, timeout, thr, Clock::now());       // set up timeout
+    thr->suspend(tw.lock);
+  } else {
+    tw.lock.release();
+  }
+}
+
+// bLock held: preemption already disabled
+bool TimeoutEventInfo::suspend(IntrusiveList<Thread>& queue, mword timeout) {
+  Thread* thr = CurrThread();
+  TimerWheel& tw = Runtime::CurrTimerWheel();
+  tw.lock.acquire();
+  if (thr->block(this)) {
+    queue.push_back(*thr);                             // set up block
+    tw.insert(node, timeout, thr, Clock::now());       // set up timeout
+    thr->suspend(bLock, tw.lock);
+    return !timedOut;
+  }
+  tw.lock.release();
+  bLock.release();
+  return false;
+}
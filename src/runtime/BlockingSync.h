@@ -22,43 +22,148 @@
 #include "runtime/Scheduler.h"
 #include "runtime/Thread.h"
 
-#include <list>
-#include <map>
+class UnblockInfo {
+public:
+  virtual void cancelTimeout() {}
+  virtual void cancelEvent(Thread& t) {}
+};
 
-class Timeout {
+class TimerWheel;
+
+// embedded in TimeoutInfo -> timeouts do not allocate memory
+class TimerNode : public IntrusiveList<TimerNode>::Link {
+  friend class TimerWheel;
+  mword deadline;
+  Thread* thread;
+  UnblockInfo* ubi;           // set when fired
+  TimerWheel* wheel;          // for cancellation from any processor
+public:
+  TimerWheel* getWheel() const { return wheel; }
+};
+
+// per-processor hierarchical timing wheel with O(1) insert and cancel;
+// 4 levels of 64 slots (1 tick each at level 0), plus overflow list
+class TimerWheel {
   friend class TimeoutInfo;
   friend class TimeoutEventInfo;
-  static BasicLock lock;
-  static multimap<mword,Thread*> queue;
+  static const mword bits = 6;
+  static const mword slots = pow2<mword>(bits);
+  static const mword levels = 4;
+
+  BasicLock lock;
+  mword current;              // last tick processed
+  mword count;                // timers in wheel
+  IntrusiveList<TimerNode> wheel[levels][slots];
+  IntrusiveList<TimerNode> overflow;
+
+  void place(TimerNode& n) {  // n.deadline >= current
+    mword delta = n.deadline - current;
+    for (mword l = 0; l < levels; l += 1) {
+      if (delta < pow2<mword>(bits * (l + 1))) {
+        wheel[l][(n.deadline >> (bits * l)) % slots].push_back(n);
+        return;
+      }
+    }
+    overflow.push_back(n);
+  }
+
+  void cascade(IntrusiveList<TimerNode>& list) {
+    IntrusiveList<TimerNode> tmp;
+    while (!list.empty()) tmp.push_back(*list.pop_front());
+    while (!tmp.empty()) place(*tmp.pop_front());
+  }
+
+  // lock held; an empty wheel might be stale (tickless idle): catch up first
+  void insert(TimerNode& n, mword deadline, Thread* t, mword now) {
+    if (count == 0) current = max(current, now);
+    n.deadline = max(deadline, current + 1);
+    n.thread = t;
+    n.ubi = nullptr;
+    n.wheel = this;
+    count += 1;
+    place(n);
+  }
+
+  // lock held; node might have fired already
+  void remove(TimerNode& n) {
+    if (!n.onList()) return;
+    IntrusiveList<TimerNode>::remove(n);
+    count -= 1;
+  }
+
+  // next occupied level-0 slot, but not beyond the next cascade
+  mword nextTick() const {
+    mword wrap = (current | (slots - 1)) + 1;
+    for (mword t = current + 1; t < wrap; t += 1) {
+      if (!wheel[0][t % slots].empty()) return t;
+    }
+    return wrap;
+  }
+
+  // lock held; fired timers have been claimed via getUnblockInfo()
+  void advance(mword now, IntrusiveList<TimerNode>& fired) {
+    while (current < now) {
+      if (count == 0) { current = now; return; }
+      current = min(nextTick(), now);         // skip empty slots
+      for (mword l = 1; l <= levels; l += 1) { // cascade, if lower level wraps
+        if (current % pow2<mword>(bits * l) != 0) break;
+        if (l == levels) cascade(overflow);
+        else cascade(wheel[l][(current >> (bits * l)) % slots]);
+      }
+      IntrusiveList<TimerNode>& due = wheel[0][current % slots];
+      for (TimerNode* n = due.front(); n != due.fence(); ) {
+        TimerNode* nn = IntrusiveList<TimerNode>::next(*n);
+        n->ubi = n->thread->getUnblockInfo();
+        if (n->ubi) {         // otherwise: resumed elsewhere, then cancelled
+          IntrusiveList<TimerNode>::remove(*n);
+          fired.push_back(*n);
+          count -= 1;
+        }
+        n = nn;
+      }
+    }
+  }
 
 public:
-  static inline void sleep(mword timeout);
-  static inline void checkExpiry(mword now);
+  TimerWheel() : current(0), count(0) {}
+
+  void checkExpiry(mword now) {
+    IntrusiveList<TimerNode> fired;
+    lock.acquire();
+    advance(now, fired);
+    lock.release();
+    while (!fired.empty()) {
+      TimerNode* n = fired.pop_front();
+      Thread* t = n->thread;  // n invalid after resume
+      n->ubi->cancelEvent(*t);
+      t->resume();
+    }
+  }
+
+  // earliest tick with work, conservative; no lock needed
+  mword nextDeadline() const {
+    if (count == 0) return limit<mword>();
+    return nextTick();
+  }
 };
 
-class UnblockInfo {
+class Timeout {
 public:
-  virtual void cancelTimeout() {}
-  virtual void cancelEvent(Thread& t) {}
+  static inline void sleep(mword timeout);
+  static void sleepNanos(mword deadline);
+  static void checkExpiry(mword now);
+  static mword nextDeadline();
 };
 
 class TimeoutInfo : public virtual UnblockInfo {
 protected:
-  decltype(Timeout::queue)::iterator titer;
+  TimerNode node;
 public:
-  void suspend(mword timeout) {
-    Thread* thr = CurrThread();
-    Timeout::lock.acquire();
-    if (thr->block(this)) {
-      titer = Timeout::queue.insert( {timeout, thr} ); // set up timeout
-      thr->suspend(Timeout::lock);
-    } else {
-      Timeout::lock.release();
-    }
-  }
+  void suspend(mword timeout);
   virtual void cancelTimeout() {
-    AutoLock al(Timeout::lock);
-    Timeout::queue.erase(titer);
+    TimerWheel& tw = *node.getWheel();
+    AutoLock al(tw.lock);
+    tw.remove(node);
   }
 };
 
@@ -90,19 +195,7 @@ public:
 class TimeoutEventInfo : public TimeoutInfo, public EventInfo {
 public:
   TimeoutEventInfo(BasicLock& bl) : EventInfo(bl) {}
-  bool suspend(IntrusiveList<Thread>& queue, mword timeout) {
-    Thread* thr = CurrThread();
-    Timeout::lock.acquire();
-    if (thr->block(this)) {
-      queue.push_back(*thr);                           // set up block
-      titer = Timeout::queue.insert( {timeout, thr} ); // set up timeout
-      thr->suspend(bLock, Timeout::lock);
-      return !timedOut;
-    }
-    Timeout::lock.release();
-    bLock.release();
-    return false;
-  }
+  bool suspend(IntrusiveList<Thread>& queue, mword timeout);
 };
 
 inline void Timeout::sleep(mword timeout) {
@@ -110,27 +203,6 @@ inline void Timeout::sleep(mword timeout) {
   ti.suspend(timeout);
 }
 
-inline void Timeout::checkExpiry(mword now) {
-
-  list<pair<Thread*,UnblockInfo*>> fireList;
-  lock.acquire();
-  for (auto it = queue.begin(); it != queue.end() && it->first <= now; ) {
-    Thread* t = it->second;
-    UnblockInfo* ubi = t->getUnblockInfo();
-    if (ubi) {
-      it = queue.erase(it);
-      fireList.push_back( {t, ubi} );
-    } else {
-      it = next(it);
-    }
-  }
-  lock.release();
-  for (auto f : fireList) {
-    f.second->cancelEvent(*f.first);
-    f.first->resume();
-  }
-}
-
 class BlockingQueue {
   IntrusiveList<Thread> queue;
 
@@ -155,11 +227,14 @@ public:
     return false;
   }
 
-  bool resume(BasicLock& bLock, Thread*& t) {
-    for (t = queue.front(); t != queue.fence(); t = IntrusiveList<Thread>::next(*t)) {
+  // 'handoff' is invoked before bLock is released and the thread resumes
+  template<typename Handoff>
+  bool resume(BasicLock& bLock, Handoff handoff) {
+    for (Thread* t = queue.front(); t != queue.fence(); t = IntrusiveList<Thread>::next(*t)) {
       UnblockInfo* ubi = t->getUnblockInfo();
       if (ubi) {
         IntrusiveList<Thread>::remove(*t);
+        handoff(t);
         bLock.release();
         ubi->cancelTimeout();
         t->resume();
@@ -169,36 +244,92 @@ public:
     return false;
   }
 
+  bool resume(BasicLock& bLock, Thread*& t) { return resume(bLock, [&t](Thread* n) { t = n; }); }
   bool resume(BasicLock& bl) { Thread* dummy; return resume(bl, dummy); }
 };
 
+// uncontended acquire/release: single CAS on 'owner', no internal lock
+// contended: spin while owner is running elsewhere, then block
 class Mutex {
 protected:
   BasicLock lock;
-  Thread* owner;
+  mword owner;                                  // Thread* | Waiters
+  mword ownerCPU;                               // hint: processor of owner
   BlockingQueue bq;
 
+  static const mword Waiters = 1;               // release must check queue
+
+  Thread* getOwner() const { return (Thread*)(owner & ~Waiters); }
+
+  void setOwnerCPU() { __atomic_store_n(&ownerCPU, LocalProcessor::getIndex(), __ATOMIC_RELAXED); }
+
+  bool tryLock(mword expected = 0) {
+    if (!__atomic_compare_exchange_n(&owner, &expected, mword(CurrThread()), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return false;
+    setOwnerCPU();
+    return true;
+  }
+
+  bool spinAcquire();
+
+#if TESTING_LOCK_PROFILE
+  mword holdStart;
+  mword holdSite;
+  bool profile(mword tsc, bool contended, bool success) {
+    if (success) {
+      holdStart = CPU::readTSC();
+      holdSite = LockProfile::acquired(this, holdStart - tsc, contended);
+    }
+    return success;
+  }
+#endif
+
   bool internalAcquire(bool ownerLock, mword timeout = limit<mword>()) {
-    if slowpath(owner == CurrThread()) {
+    if slowpath(getOwner() == CurrThread()) {
       GENASSERT1(ownerLock, FmtHex(owner));
-    } else {
-      lock.acquire();
-      if slowpath(owner != nullptr) return bq.block(lock, timeout);
-      owner = CurrThread();
-      lock.release();
+      return true;
+    }
+#if TESTING_LOCK_PROFILE
+    mword tsc = CPU::readTSC();
+    if fastpath(tryLock()) return profile(tsc, false, true);
+    return profile(tsc, true, contendedAcquire(timeout));
+#else
+    if fastpath(tryLock()) return true;
+    return contendedAcquire(timeout);
+#endif
+  }
+
+  bool contendedAcquire(mword timeout) {
+    if (spinCycles && spinAcquire()) return true;
+    lock.acquire();
+    for (;;) {
+      mword o = __atomic_load_n(&owner, __ATOMIC_RELAXED);
+      if (o == 0) {
+        if (tryLock()) { lock.release(); return true; }
+      } else if ((o & Waiters) || __atomic_compare_exchange_n(&owner, &o, o | Waiters, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        if (!bq.block(lock, timeout)) return false;
+        setOwnerCPU();                          // baton passed
+        return true;
+      }
     }
-    return true;
   }
 
   void internalRelease() {
-    if slowpath(!bq.resume(lock, owner)) {      // try baton passing
-      owner = nullptr;                          // baton not passed
+#if TESTING_LOCK_PROFILE
+    LockProfile::released(holdSite, CPU::readTSC() - holdStart);
+#endif
+    mword expected = mword(CurrThread());
+    if fastpath(__atomic_compare_exchange_n(&owner, &expected, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+    lock.acquire();                             // try baton passing
+    if slowpath(!bq.resume(lock, [this](Thread* t) { __atomic_store_n(&owner, mword(t) | (bq.empty() ? 0 : Waiters), __ATOMIC_RELEASE); })) {
+      __atomic_store_n(&owner, 0, __ATOMIC_RELEASE); // baton not passed
       lock.release();
     }
   }
 
 public:
-  Mutex() : owner(nullptr) {}
+  static mword spinCycles;                      // 0: always block immediately
+
+  Mutex() : owner(0), ownerCPU(0) {}
 
   bool acquire() {
     return internalAcquire(false);
@@ -209,8 +340,7 @@ public:
   }
 
   void release() {
-    GENASSERT1(owner == CurrThread(), FmtHex(owner));
-    lock.acquire();
+    GENASSERT1(getOwner() == CurrThread(), FmtHex(owner));
     internalRelease();
   }
 };
@@ -230,12 +360,10 @@ public:
   }
 
   mword release() {
-    lock.acquire();
-    GENASSERT1(owner == CurrThread(), FmtHex(owner));
+    GENASSERT1(getOwner() == CurrThread(), FmtHex(owner));
     counter -= 1;
     mword retval = counter;
     if (counter == 0) internalRelease();
-    else lock.release();
     return retval;
   }
 };
@@ -26,6 +26,8 @@ typedef SpinLock BasicLock;
 typedef ScopedLock<BasicLock> AutoLock;
 
 class AddressSpace;
+class Scheduler;
+class TimerWheel;
 class FrameManager;
 class Thread;
 class SystemProcessor;
@@ -75,10 +77,11 @@ struct Runtime {
 
   static inline vaddr allocThreadStack(size_t ss);
   static inline void releaseThreadStack(vaddr vma, size_t ss);
+  static inline size_t threadStackUsage(vaddr vma, size_t ss);
 
   /**** idle loop ****/
 
-  static inline void idleLoop();
+  static inline void idleLoop(Scheduler* sched);
   static inline void wake(SystemProcessor& sp);
 
   /**** thread switch ****/
@@ -88,6 +91,9 @@ struct Runtime {
     KASSERT0(t);
     return t;
   }
+  static inline Scheduler& CurrScheduler();
+  static inline TimerWheel& CurrTimerWheel();
+  static inline bool running(Thread* t, mword cpu);
   static inline void preThreadSwitch(Thread* nextThread);
   static inline void postThreadSwitch(Thread* prevThread);
 };
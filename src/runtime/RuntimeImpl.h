@@ -19,27 +19,44 @@
 
 #if defined(__KOS__)
 
+#include "runtime/BlockingSync.h"
 #include "runtime/Runtime.h"
+#include "runtime/Scheduler.h"
 #include "kernel/AddressSpace.h"
 #include "kernel/Clock.h"
+#include "kernel/StackPool.h"
+#include "machine/Machine.h"
 
 inline vaddr Runtime::allocThreadStack(size_t ss) {
-  return kernelAS.allocStack(ss);
+  return StackPool::alloc(ss);
 }
 
 inline void Runtime::releaseThreadStack(vaddr vma, size_t ss) {
-  kernelAS.releaseStack(vma, ss);
+  StackPool::release(vma, ss);
 }
 
-void Runtime::idleLoop() {
+inline size_t Runtime::threadStackUsage(vaddr vma, size_t ss) {
+  return kernelAS.stackCommitted(vma, ss);
+}
+
+void Runtime::idleLoop(Scheduler* sched) {
   for (;;) {
     mword e = LocalProcessor::getEpoch();
     mword tick = Clock::now() + 10;
     while (e == LocalProcessor::getEpoch()) {
-      if (Clock::now() < tick) CPU::Pause();
-      else if (!CurrFM().zeroMemory()) {
-        DBG::outl(DBG::Idle, "idle halt");
-        CPU::Halt();
+      if (sched->steal()) {}            // found work -> yield to it
+      else if (Clock::now() < tick) CPU::Pause();
+      else if (!CurrFM().zeroIdle()) {
+        LocalProcessor::lock(true);
+        if (sched->reportIdle(*LocalProcessor::self())) {
+          DBG::outl(DBG::Idle, "idle halt");
+          Machine::idleTimer(Timeout::nextDeadline());
+          LocalProcessor::unlockHalt();
+          Machine::startTimer();
+          sched->reportBusy();
+        } else {
+          LocalProcessor::unlock(true);
+        }
       }
       CurrThread()->yield();
     }
@@ -51,6 +68,20 @@ inline void Runtime:: wake(SystemProcessor& sp) {
   sp.sendWakeIPI();
 }
 
+inline Scheduler& Runtime::CurrScheduler() {
+  return LocalProcessor::self()->getScheduler();
+}
+
+// caller must disable preemption until the wheel's lock is held: a timer
+// inserted into another core's wheel is not seen, if that core is tickless
+inline TimerWheel& Runtime::CurrTimerWheel() {
+  return Machine::getProcessor(LocalProcessor::getIndex()).getTimerWheel();
+}
+
+inline bool Runtime::running(Thread* t, mword cpu) {
+  return Machine::getProcessor(cpu).getRunningThread() == t;
+}
+
 inline void Runtime::preThreadSwitch(Thread* nextThread) {
   CHECK_LOCK_COUNT(1);
   AddressSpace& nextAS = nextThread->getMemCtx();
@@ -64,6 +95,7 @@ inline void Runtime::postThreadSwitch(Thread* prevThread) {
   CHECK_LOCK_COUNT(1);
   AddressSpace& nextAS = CurrThread()->getMemCtx();
   nextAS.postThreadResume();
+  kernelAS.refillStackReserve();
   if slowpath(prevThread) {            // cf. postSwitch() in Scheduler.cc
     AddressSpace& prevAS = prevThread->getMemCtx();
     prevThread->destroy();
@@ -17,6 +17,36 @@
 #include "runtime/RuntimeImpl.h"
 #include "runtime/Scheduler.h"
 
-void Scheduler::wakeUp() {
-  if (idler) Runtime::wake(*idler);
+bool BaseScheduler::stealing = true;
+
+Thread* Scheduler::dequeue(size_t maxlevel) {
+  size_t level = min(maxlevel, idlePriority);
+  Thread* t = BaseScheduler::dequeue(level);
+  if (!t && group) t = group->dequeueSwitchedOut(level); // cf. switchThread
+  if (!t && maxlevel > level) t = BaseScheduler::dequeue(maxlevel);
+  return t;
+}
+
+// preemption disabled; false -> work has arrived, do not halt
+bool Scheduler::reportIdle(SystemProcessor& sp) {
+  __atomic_store_n(&idler, &sp, __ATOMIC_SEQ_CST);
+  if (empty() && (!group || group->reportIdle(*this))) return true;
+  reportBusy();
+  return false;
+}
+
+void Scheduler::reportBusy() {
+  __atomic_store_n(&idler, nullptr, __ATOMIC_SEQ_CST);
+  if (group) group->reportBusy(*this);
+}
+
+// fence: queue update before 'idler' check (cf. reportIdle); plain load
+// first, so that enqueueing on busy schedulers does not write the line
+bool Scheduler::wakeUp() {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if fastpath(!__atomic_load_n(&idler, __ATOMIC_RELAXED)) return false;
+  SystemProcessor* sp = __atomic_exchange_n(&idler, nullptr, __ATOMIC_SEQ_CST);
+  if (!sp) return false;
+  Runtime::wake(*sp);
+  return true;
 }
@@ -28,14 +28,50 @@ protected:  // very simple N-class prio scheduling
 
 private:
   BaseScheduler* peer;
+  BaseScheduler** victims;  // steal candidates, nearest first
+  size_t victimCount;
   BaseScheduler(const BaseScheduler&) = delete;            // no copy
   BaseScheduler& operator=(const BaseScheduler&) = delete; // no assignment
 
+  // unlocked check for stealable work; idle thread (idlePriority) excluded
+  bool stealable() const {
+    for (mword i = 0; i < idlePriority; i += 1) {
+      if (!readyQueue[i].empty()) return true;
+    }
+    return false;
+  }
+
+  // victim lock held: take most recently queued thread without affinity;
+  // skip threads resumed before their suspending CPU has left their stack
+  Thread* stealInternal() {
+    for (mword i = 0; i < idlePriority; i += 1) {
+      for (Thread* t = readyQueue[i].back(); t != readyQueue[i].fence(); t = readyQueue[i].prev(*t)) {
+        if (t->getAffinity() || !t->isSwitchedOut()) continue;
+        readyCount -= 1;
+        return readyQueue[i].remove(*t);
+      }
+    }
+    return nullptr;
+  }
+
+  void enqueueInternal(Thread& t) {
+    Runtime::debugS("Thread ", FmtHex(&t), " queueing on ", FmtHex(this));
+    GENASSERT1(t.getPriority() < maxPriority, t.getPriority());
+    lock.acquire();
+    readyCount += 1;
+    readyQueue[t.getPriority()].push_back(t);
+    lock.release();
+    wakeUp();                 // no-op, unless idle processor to wake up
+  }
+
 public:
-  BaseScheduler() : readyCount(0), peer(this) {}
+  static bool stealing;     // idle schedulers pull work instead of peer push
+
+  BaseScheduler() : readyCount(0), peer(this), victims(nullptr), victimCount(0) {}
   virtual ~BaseScheduler() {}
   bool empty() const { return readyCount == 0; }
   void setPeer(BaseScheduler& p) { peer = &p; }
+  void setVictims(BaseScheduler** v, size_t c) { victims = v; victimCount = c; }
 
   Thread* dequeue(size_t maxlevel) {
     AutoLock al(lock);
@@ -48,23 +84,27 @@ public:
     return nullptr;
   }
 
-  void enqueue(Thread& t, _friend<Thread>) {
-    Runtime::debugS("Thread ", FmtHex(&t), " queueing on ", FmtHex(this));
-    GENASSERT1(t.getPriority() < maxPriority, t.getPriority());
-    lock.acquire();
-    bool wake = (readyCount == 0);
-    readyCount += 1;
-    readyQueue[t.getPriority()].push_back(t);
-    lock.release();
-    if (wake) wakeUp();
+  // shared queue: only threads whose last CPU has left their stack
+  Thread* dequeueSwitchedOut(size_t maxlevel) {
+    AutoLock al(lock);
+    for (mword i = 0; i < maxlevel; i += 1) {
+      for (Thread* t = readyQueue[i].front(); t != readyQueue[i].fence(); t = readyQueue[i].next(*t)) {
+        if (!t->isSwitchedOut()) continue;
+        readyCount -= 1;
+        return readyQueue[i].remove(*t);
+      }
+    }
+    return nullptr;
   }
 
+  void enqueue(Thread& t, _friend<Thread>) { enqueueInternal(t); }
+
   void enqueueBalanced(Thread& t, _friend<Thread> ft) {
 #if TESTING_ALWAYS_MIGRATE
     t.setScheduler(*peer);
     peer->enqueue(t, ft);
-#else /* simple load balancing */
-    if (peer->readyCount + 2 < readyCount) {
+#else /* simple load balancing, unless idle schedulers steal */
+    if (!stealing && peer->readyCount + 2 < readyCount) {
       t.setScheduler(*peer);
       peer->enqueue(t, ft);
     } else {
@@ -73,22 +113,68 @@ public:
 #endif
   }
 
-  virtual void wakeUp() = 0;
+  // called from idle loop: move one thread from the nearest busy victim
+  bool steal() {
+#if TESTING_NEVER_MIGRATE
+    return false;
+#else
+    if (!stealing) return false;
+    for (size_t i = 0; i < victimCount; i += 1) {
+      BaseScheduler& v = *victims[i];
+      if (!v.stealable() || !v.lock.tryAcquire()) continue; // avoid contention
+      Thread* t = v.stealInternal();
+      v.lock.release();
+      if (t) {
+        Runtime::debugS("Thread ", FmtHex(t), " stolen from ", FmtHex(&v));
+        t->setScheduler(*this);
+        enqueueInternal(*t);
+        return true;
+      }
+    }
+    return false;
+#endif
+  }
+
+  virtual bool wakeUp() = 0;
 };
 
+class GroupScheduler;
+
 class Scheduler : public BaseScheduler {
-  SystemProcessor* idler;
+  SystemProcessor* idler;   // set while processor is halted
+  GroupScheduler* group;    // optional: shared ready queue for core group
 public:
-  Scheduler() : idler(nullptr) {}
-  void reportIdle(SystemProcessor& sp) { idler = &sp; }
-  virtual void wakeUp();
+  Scheduler() : idler(nullptr), group(nullptr) {}
+  void setGroup(GroupScheduler* g) { group = g; }
+  Thread* dequeue(size_t maxlevel);
+  bool reportIdle(SystemProcessor& sp);
+  void reportBusy();
+  virtual bool wakeUp();
 };
 
+// shared by a set of processors; wakes at most one idle processor per enqueue
 class GroupScheduler : public BaseScheduler {
   IntrusiveList<BaseScheduler> idleQueue;
 public:
-  bool reportIdle(BaseScheduler& bs) { return false; }
-//  virtual void wakeUp();
+  bool reportIdle(BaseScheduler& bs) {
+    AutoLock al(lock);
+    if (readyCount > 0) return false;
+    if (!bs.onList()) idleQueue.push_back(bs);
+    return true;
+  }
+  void reportBusy(BaseScheduler& bs) {
+    AutoLock al(lock);
+    if (bs.onList()) idleQueue.remove(bs);
+  }
+  virtual bool wakeUp() {
+    for (;;) {
+      lock.acquire();
+      BaseScheduler* bs = idleQueue.empty() ? nullptr : idleQueue.pop_front();
+      lock.release();
+      if (!bs) return false;
+      if (bs->wakeUp()) return true;  // skip processors already awake
+    }
+  }
 };
 
 #endif /* _Scheduler_h_ */
@@ -31,9 +31,15 @@ void Thread::destroy() {
   GENASSERT1(state == Finishing, state);
   GENASSERT1(unblockInfo == nullptr, FmtHex(unblockInfo));
   Runtime::debugT("Thread destroy: ", FmtHex(stackBottom), '/', FmtHex(stackSize), '/', FmtHex(this));
+  if slowpath(DBG::test(DBG::Threads)) Runtime::debugT("Thread stack used: ", FmtHex(getStackUsage()));
   Runtime::releaseThreadStack(stackBottom, stackSize);
 }
 
+// stack memory in use (high-water mark), cf. lazy kernel stacks
+size_t Thread::getStackUsage() const {
+  return Runtime::threadStackUsage(stackBottom, stackSize);
+}
+
 static inline void unlock() {}
 
 template<typename... Args>
@@ -45,8 +51,10 @@ static inline void unlock(BasicLock &l, Args&... a) {
 template<typename... Args>
 inline void Thread::switchThread(bool yield, Args&... a) {
   CHECK_LOCK_MIN(sizeof...(Args));
-  Thread* nextThread = scheduler->dequeue(yield ? idlePriority : maxPriority);
+  __atomic_store_n(&switchedOut, false, __ATOMIC_RELAXED); // before unlock
+  Thread* nextThread = Runtime::CurrScheduler().dequeue(yield ? idlePriority : maxPriority);
   unlock(a...); // REMEMBER: unlock early, because suspend/resume to same CPU!
+                // other CPUs wait for 'switchedOut' (cf. steal, group queue)
   Runtime::debugS("Thread switch <", (yield ? 'Y' : 'S'), ">: ", FmtHex(this), " to ", FmtHex(nextThread));
   if (nextThread) {
     GENASSERTN(this != nextThread, FmtHex(this), ' ', FmtHex(nextThread));
@@ -69,6 +77,7 @@ inline void Thread::switchThread(bool yield, Args&... a) {
 Thread* Thread::postYield(Thread* prevThread) {
   CHECK_LOCK_COUNT(1);
   GENASSERT1(!prevThread->finishing(), FmtHex(prevThread));
+  __atomic_store_n(&prevThread->switchedOut, true, __ATOMIC_RELEASE);
 #if TESTING_NEVER_MIGRATE
   prevThread->scheduler->enqueue(*prevThread, _friend<Thread>());
 #else /* migration enabled */
@@ -81,6 +90,7 @@ Thread* Thread::postYield(Thread* prevThread) {
 // return 'prevThread' only if the previous thread needs to be destroyed
 Thread* Thread::postSuspend(Thread* prevThread) {
   CHECK_LOCK_COUNT(1);
+  __atomic_store_n(&prevThread->switchedOut, true, __ATOMIC_RELEASE);
   if slowpath(prevThread->finishing()) return prevThread;
   return nullptr;
 }
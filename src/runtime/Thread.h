@@ -39,6 +39,7 @@ class Thread : public IntrusiveList<Thread>::Link {
   mword priority;           // scheduling priority
 
   enum State { Running, Cancelled, Finishing } state;
+  bool switchedOut;         // stack pointer saved: can run on another CPU
   UnblockInfo* unblockInfo; // unblock vs. timeout vs. cancel
 
   Runtime::MemoryContext memctx;
@@ -57,13 +58,15 @@ protected:
   Thread(vaddr sb, size_t ss, Runtime::MemoryContext& mc) :
     stackPointer(vaddr(this)), stackBottom(sb), stackSize(ss),
     scheduler(nullptr), affinity(false), priority(defPriority),
-    state(Running), unblockInfo(nullptr), memctx(mc) {}
+    state(Running), switchedOut(true), unblockInfo(nullptr), memctx(mc) {}
 
 public:
   static Thread* create(size_t ss);
   static Thread* create() { return create(defaultStack); }
   void destroy();
 
+  size_t getStackUsage() const;
+
   void direct(ptr_t func, ptr_t p1 = nullptr, ptr_t p2 = nullptr, ptr_t p3 = nullptr, ptr_t p4 = nullptr) {
     if (!affinity) scheduler = CurrThread()->scheduler;
     stackDirect(stackPointer, func, p1, p2, p3, p4);
@@ -102,6 +105,7 @@ public:
 
   bool cancelled() const       { return state == Cancelled; }
   bool finishing() const       { return state == Finishing; }
+  bool isSwitchedOut() const   { return __atomic_load_n(&switchedOut, __ATOMIC_ACQUIRE); }
   Thread* setPriority(mword p) { priority = p; return this; }
   mword getPriority() const    { return priority; }
   Thread* setAffinity(bool a)  { affinity = a; return this; }
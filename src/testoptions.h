@@ -1,12 +1,43 @@
 //#define TESTING_ALWAYS_MIGRATE    1
+//#define TESTING_CLOCK_TEST        1
 //#define TESTING_DEBUG_STDOUT      1
+//#define TESTING_FIBER_TEST        1
+//#define TESTING_FORK_TEST         1
+//#define TESTING_FUTEX_TEST        1
+//#define TESTING_HEAP_TEST         1
 //#define TESTING_KEYCODE_LOOP      1
-#define TESTING_MEMORY_HOG        1
+//#define TESTING_LOCK_PROFILE      1
+//#define TESTING_MEMORY_HOG        1
 #define TESTING_MEMORY_NO_CACHE   1
+//#define TESTING_MUTEX_BENCH       1
+//#define TESTING_NEVER_FRAMECACHE  1
+//#define TESTING_NEVER_HUGEPAGES   1
+//#define TESTING_NEVER_MAGAZINES   1
 //#define TESTING_NEVER_MIGRATE     1
+//#define TESTING_NEVER_PCID        1
+//#define TESTING_NEVER_SHOOTDOWN   1
+//#define TESTING_NEVER_STACKPOOL   1
 //#define TESTING_NEVER_ALLOC_LAZY  1
+//#define TESTING_NEVER_TICKLESS    1
+//#define TESTING_NEVER_ZERODAEMON  1
+//#define TESTING_NEVER_ZEROPAGE    1
+//#define TESTING_PCID_TEST         1
 #define TESTING_PING_LOOP         1
+//#define TESTING_PREEMPT_TEST      1
+//#define TESTING_RECLAIM_TEST      1
 //#define TESTING_REPORT_INTERRUPTS 1
+//#define TESTING_SCHEDULER_TEST    1
+//#define TESTING_SPAWN_TEST        1
+//#define TESTING_SPINLOCK_BACKOFF  1
+//#define TESTING_SPINLOCK_MCS      1
+//#define TESTING_SPINLOCK_TEST     1
+//#define TESTING_SPINLOCK_TICKET   1
+//#define TESTING_STACK_TEST        1
+//#define TESTING_SYNC_TEST         1
+//#define TESTING_THREAD_TEST       1
+//#define TESTING_TIMEOUT_TEST      1
+//#define TESTING_TLB_TEST          1
+//#define TESTING_ZERO_TEST         1
 #define TESTING_STDOUT_DEBUG      1
 #define TESTING_STDERR_DEBUG      1
 #define TESTING_TIMER_TEST        1
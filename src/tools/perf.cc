@@ -1,37 +1,18 @@
 #include "perf.h"
 
-void set_timer(){
-  KOUT::outl("apicid from perf_init ", LocalProcessor::getApicID());
-  LocalProcessor::setApicTimer();
-}
-
-
-void clear_timer(){
-  KOUT::outl("apicid from perf_init ", LocalProcessor::getApicID());
-  LocalProcessor::clearApicTimer();
-}
-
-
 void Perf::data_struct_init(){
 		for (mword i = 0; i < Machine::getProcessorCount(); i++) {
       per_core_perf.push_back(Queue());
     }
 }
 
+// samples are taken by the local APIC timer (preemption) interrupt
 void Perf::timer_init(){
-	for (mword i = 0; i < Machine::getProcessorCount(); i++) {
-    	Thread* t = Thread::create();
-    	t->setScheduler(Machine::getProcessor(i).getScheduler())->setAffinity(true);
-    	t->start((ptr_t)set_timer);
-    }
+	sampling = true;
 }
 
 void Perf::timer_clear(){
-	for (mword i = 0; i < Machine::getProcessorCount(); i++) {
-    	Thread* t = Thread::create();
-    	t->setScheduler(Machine::getProcessor(i).getScheduler())->setAffinity(true);
-    	t->start((ptr_t)clear_timer);
-    }
+	sampling = false;
 }
 
 void Perf::start() {
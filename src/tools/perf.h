@@ -20,6 +20,7 @@ static int TOTAL_SAMPLES = 10000;
 class Perf {
 private:
 	bool data_ready_flag;
+	volatile bool sampling;
 	HashMap* hash_perf;
 	vector<Queue> per_core_perf;
 	void data_struct_init();
@@ -30,12 +31,14 @@ private:
 public:
 	Perf() { 
 		data_ready_flag = false; 
+		sampling = false;
 		hash_perf = new HashMap();
 		}
 	~Perf() { delete hash_perf; }
 	void put_sample(sampleD);
 	void start();
 	bool is_data_ready();
+	bool is_sampling() { return sampling; }
 	void stop();
 	void print();
 	void print_core_buf();
@@ -0,0 +1,423 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+#include "fiber.h"
+
+// Fiber stacks are aligned to their size and carry the Fiber record at the
+// top, so fiber_self() masks %rsp instead of needing thread-local storage;
+// the lowest page of each stack is unmapped as overflow guard.
+static const size_t fiberStackSize = 1 << 16;
+static const size_t guardSize      = 1 << 12;
+static const size_t arenaStacks    = 16;         // below huge-page mmap size
+static const int    stackCacheSize = 16;         // per-VP free stacks
+static const int    maxVPs         = 64;
+static const int    maxCarriers    = 256;
+
+// carried out on the scheduler stack after switching away from a fiber
+enum PostAction : mword { PostNone, PostReady, PostUnlock, PostExit };
+
+struct VP;
+struct Fiber;
+
+struct Carrier {
+  mword           rsp;       // scheduler context
+  VP*             vp;        // nullptr: spare or inside blocking call
+  Carrier*        next;      // spare list
+  mword           sem;       // kernel semaphore: parked as spare
+  PostAction      post;
+  Fiber*          postFiber;
+  volatile mword* postLock;
+};
+
+struct Fiber {
+  mword       rsp;           // saved context
+  Fiber*      next;          // run queue, semaphore queue, or free list
+  VP*         vp;            // virtual processor last run on
+  Carrier*    carrier;       // kernel thread currently running the fiber
+  void*     (*func)(void*);
+  void*       arg;
+  void*       result;
+  fiber_sem_t done;
+};
+
+static const size_t fiberRecord = (sizeof(Fiber) + 15) & ~size_t(15);
+
+static inline Fiber* fiberRecordOf(mword stack) {
+  return (Fiber*)(stack + fiberStackSize - fiberRecord);
+}
+
+struct VP {
+  volatile mword lock;
+  Fiber*         head;
+  Fiber*         tail;
+  volatile mword sleeping;   // carrier about to block on 'sem'
+  mword          sem;        // kernel semaphore: idle carrier
+  int            stackCount; // only touched by the bound carrier
+  Fiber*         stackCache[stackCacheSize];
+} __attribute__((aligned(64)));
+
+static VP       vpArray[maxVPs];
+static int      vpCount = 0;
+
+static Carrier  carrierArray[maxCarriers];
+static int      carrierCount = 0;
+static Carrier* spares = nullptr;
+static volatile mword spareLock = 0;
+static volatile mword stopping = 0;
+
+static Fiber*   freeStacks = nullptr;
+static volatile mword stackLock = 0;
+
+static void*  (*mainFunc)(void*) = nullptr;
+static void*    mainResult = nullptr;
+static mword    mainSem;
+
+extern "C" void _fiber_switch(mword* save, mword next);
+extern "C" void _fiber_trampoline();
+
+static inline void acquire(volatile mword& l) {
+  while (__atomic_exchange_n(&l, 1, __ATOMIC_ACQUIRE)) {
+    while (l) asm volatile("pause");
+  }
+}
+
+static inline void release(volatile mword& l) {
+  __atomic_store_n(&l, 0, __ATOMIC_RELEASE);
+}
+
+static void refillStacks() {                      // called with stackLock
+  size_t len = (arenaStacks + 1) * fiberStackSize;
+  void* mem = mmap(nullptr, len, 0, 0, -1, 0);
+  if (mem == MAP_FAILED) return;
+  mword base = (mword(mem) + fiberStackSize - 1) & ~(fiberStackSize - 1);
+  for (size_t i = 0; i < arenaStacks; i += 1) {
+    mword stack = base + i * fiberStackSize;
+    munmap((void*)stack, guardSize);
+    Fiber* f = fiberRecordOf(stack);
+    f->next = freeStacks;
+    freeStacks = f;
+  }
+}
+
+static Fiber* allocFiber(VP* vp) {
+  if (vp->stackCount > 0) return vp->stackCache[--vp->stackCount];
+  acquire(stackLock);
+  if (!freeStacks) refillStacks();
+  Fiber* f = freeStacks;
+  if (f) freeStacks = f->next;
+  release(stackLock);
+  return f;
+}
+
+static void releaseFiber(Fiber* f, VP* vp) {
+  if (vp->stackCount < stackCacheSize) {
+    vp->stackCache[vp->stackCount++] = f;
+    return;
+  }
+  acquire(stackLock);
+  f->next = freeStacks;
+  freeStacks = f;
+  release(stackLock);
+}
+
+static void initFiber(Fiber* f, void* (*func)(void*), void* arg) {
+  f->func = func;
+  f->arg = arg;
+  f->result = nullptr;
+  fiber_sem_init(&f->done, 0);
+  mword* sp = (mword*)f;                          // stack below record
+  *--sp = mword(_fiber_trampoline);               // return from _fiber_switch
+  for (int i = 0; i < 6; i += 1) *--sp = 0;       // rbp, rbx, r12-r15
+  sp[1] = mword(f);                               // %rbx -> _fiber_entry
+  f->rsp = mword(sp);
+}
+
+static bool wake(VP* vp) {
+  if (!vp->sleeping || !__atomic_exchange_n(&vp->sleeping, 0, __ATOMIC_SEQ_CST)) return false;
+  semV(vp->sem);
+  return true;
+}
+
+// wake one idle peer, which steals from a VP with surplus work
+static void wakePeer(VP* vp) {
+  for (int i = 1; i < vpCount; i += 1) {
+    if (wake(&vpArray[(vp - vpArray + i) % vpCount])) return;
+  }
+}
+
+static void ready(Fiber* f, VP* vp) {
+  f->next = nullptr;
+  acquire(vp->lock);
+  bool surplus = vp->head != nullptr;
+  if (vp->tail) vp->tail->next = f;
+  else vp->head = f;
+  vp->tail = f;
+  release(vp->lock);
+  if (!wake(vp) && surplus) wakePeer(vp);
+}
+
+static Fiber* dequeue(VP* vp) {
+  if (!__atomic_load_n(&vp->head, __ATOMIC_RELAXED)) return nullptr;
+  acquire(vp->lock);
+  Fiber* f = vp->head;
+  if (f) {
+    vp->head = f->next;
+    if (!vp->head) vp->tail = nullptr;
+  }
+  release(vp->lock);
+  return f;
+}
+
+static Fiber* steal(VP* vp) {
+  for (int i = 1; i < vpCount; i += 1) {
+    VP* victim = &vpArray[(vp - vpArray + i) % vpCount];
+    Fiber* f = dequeue(victim);
+    if (f) {
+      if (__atomic_load_n(&victim->head, __ATOMIC_RELAXED)) wakePeer(victim);
+      return f;
+    }
+  }
+  return nullptr;
+}
+
+// announce sleep, then recheck: an enqueuer that sees 'sleeping' posts 'sem'
+static Fiber* idle(VP* vp) {
+  __atomic_store_n(&vp->sleeping, 1, __ATOMIC_SEQ_CST);
+  Fiber* f = dequeue(vp);
+  if (!f) f = steal(vp);
+  if (f || stopping) {
+    if (!__atomic_exchange_n(&vp->sleeping, 0, __ATOMIC_SEQ_CST)) semP(vp->sem);
+    return f;
+  }
+  semP(vp->sem);
+  return nullptr;
+}
+
+static void semRelease(fiber_sem_t* s, VP* vp) {
+  acquire(s->lock);
+  Fiber* w = s->head;
+  if (w) {
+    s->head = w->next;
+    if (!s->head) s->tail = nullptr;
+  } else {
+    s->count += 1;
+  }
+  release(s->lock);
+  if (w) ready(w, vp);
+}
+
+static void suspend(Fiber* f, PostAction a, volatile mword* l = nullptr) {
+  Carrier* c = f->carrier;
+  c->post = a;
+  c->postFiber = f;
+  c->postLock = l;
+  _fiber_switch(&f->rsp, c->rsp);
+}
+
+static bool park(Carrier* c) {
+  acquire(spareLock);
+  if (stopping) {
+    release(spareLock);
+    return false;
+  }
+  c->next = spares;
+  spares = c;
+  release(spareLock);
+  semP(c->sem);
+  return true;
+}
+
+static void* carrierMain(void* arg) {
+  Carrier* c = (Carrier*)arg;
+  while (!stopping) {
+    if (!c->vp) {
+      if (!park(c)) break;
+      continue;
+    }
+    Fiber* f = dequeue(c->vp);
+    if (!f) f = steal(c->vp);
+    if (!f) f = idle(c->vp);
+    if (!f) continue;
+    f->vp = c->vp;
+    f->carrier = c;
+    _fiber_switch(&c->rsp, f->rsp);
+    switch (c->post) {
+      case PostReady: ready(c->postFiber, c->postFiber->vp); break;
+      case PostUnlock: release(*c->postLock); break;
+      case PostExit: semRelease(&c->postFiber->done, c->vp); break;
+      default: break;
+    }
+    c->post = PostNone;
+  }
+  return nullptr;
+}
+
+static Carrier* startCarrier(VP* vp) {
+  acquire(spareLock);
+  if (stopping || carrierCount == maxCarriers) {
+    release(spareLock);
+    return nullptr;
+  }
+  Carrier* c = &carrierArray[carrierCount++];
+  release(spareLock);
+  c->vp = vp;
+  c->post = PostNone;
+  semCreate(&c->sem, 0);
+  pthread_t tid;
+  pthread_create(&tid, nullptr, carrierMain, c);
+  return c;
+}
+
+// give the carrier's VP to a spare (or new) carrier before blocking
+static bool handoff(Carrier* c) {
+  VP* vp = c->vp;
+  acquire(spareLock);
+  Carrier* s = stopping ? nullptr : spares;
+  if (s) spares = s->next;
+  release(spareLock);
+  c->vp = nullptr;
+  if (s) {
+    s->vp = vp;
+    semV(s->sem);
+    return true;
+  }
+  if (startCarrier(vp)) return true;
+  c->vp = vp;
+  return false;
+}
+
+static void* mainWrapper(void* arg) {
+  mainResult = mainFunc(arg);
+  semV(mainSem);
+  return nullptr;
+}
+
+extern "C" void _fiber_entry(Fiber* f) {
+  fiber_exit(f->func(f->arg));
+}
+
+extern "C" int fiber_run(int vps, void* (*func)(void*), void* arg, void** result) {
+  if (vpCount > 0 || vps < 1 || vps > maxVPs) {
+    *__errno() = EINVAL;
+    return -1;
+  }
+  semCreate(&mainSem, 0);
+  vpCount = vps;
+  for (int i = 0; i < vps; i += 1) semCreate(&vpArray[i].sem, 0);
+  Fiber* f = allocFiber(&vpArray[0]);
+  if (!f) {
+    *__errno() = EAGAIN;
+    return -1;
+  }
+  mainFunc = func;
+  initFiber(f, mainWrapper, arg);
+  ready(f, &vpArray[0]);
+  for (int i = 0; i < vps; i += 1) startCarrier(&vpArray[i]);
+  semP(mainSem);
+  if (result) *result = mainResult;
+  acquire(spareLock);                             // no new carriers after this
+  stopping = 1;
+  for (Carrier* s = spares; s; s = s->next) semV(s->sem);
+  spares = nullptr;
+  release(spareLock);
+  for (int i = 0; i < vps; i += 1) wake(&vpArray[i]);
+  return 0;
+}
+
+extern "C" int fiber_create(fiber_t* fid, void* (*func)(void*), void* arg) {
+  VP* vp = fiber_self()->carrier->vp;
+  Fiber* f = allocFiber(vp);
+  if (!f) {
+    *__errno() = EAGAIN;
+    return -1;
+  }
+  initFiber(f, func, arg);
+  *fid = f;
+  ready(f, vp);
+  return 0;
+}
+
+extern "C" int fiber_join(fiber_t fid, void** result) {
+  fiber_sem_P(&fid->done);
+  if (result) *result = fid->result;
+  releaseFiber(fid, fiber_self()->carrier->vp);
+  return 0;
+}
+
+extern "C" void fiber_exit(void* result) {
+  Fiber* f = fiber_self();
+  f->result = result;
+  suspend(f, PostExit);
+  __builtin_unreachable();
+}
+
+extern "C" void fiber_yield(void) {
+  Fiber* f = fiber_self();
+  if (!__atomic_load_n(&f->carrier->vp->head, __ATOMIC_RELAXED)) return;
+  suspend(f, PostReady);
+}
+
+extern "C" fiber_t fiber_self(void) {
+  mword sp;
+  asm volatile("movq %%rsp, %0" : "=r"(sp));
+  return fiberRecordOf(sp & ~(fiberStackSize - 1));
+}
+
+extern "C" int fiber_vp(void) {
+  return fiber_self()->carrier->vp - vpArray;
+}
+
+extern "C" int fiber_sem_init(fiber_sem_t* s, mword init) {
+  s->lock = 0;
+  s->count = init;
+  s->head = s->tail = nullptr;
+  return 0;
+}
+
+extern "C" int fiber_sem_P(fiber_sem_t* s) {
+  Fiber* f = fiber_self();
+  acquire(s->lock);
+  if (s->count > 0) {
+    s->count -= 1;
+    release(s->lock);
+    return 0;
+  }
+  f->next = nullptr;
+  if (s->tail) s->tail->next = f;
+  else s->head = f;
+  s->tail = f;
+  suspend(f, PostUnlock, &s->lock);               // unlocked after switch
+  return 0;
+}
+
+extern "C" int fiber_sem_V(fiber_sem_t* s) {
+  semRelease(s, fiber_self()->carrier->vp);
+  return 0;
+}
+
+extern "C" ssize_t fiber_syscall(mword x, mword a1, mword a2, mword a3, mword a4, mword a5) {
+  Fiber* f = fiber_self();
+  bool handed = handoff(f->carrier);
+  ssize_t ret = syscallStub(x, a1, a2, a3, a4, a5);
+  if (handed) suspend(f, PostReady);              // carrier parks as spare
+  return ret;
+}
+
+extern "C" int fiber_usleep(useconds_t usecs) {
+  return fiber_syscall(SyscallNum::usleep, usecs);
+}
@@ -17,6 +17,7 @@
 #include "syscalls.h"
 
 #include <cstring>
+#include <ctime>
 
 int signum = 0;
 
@@ -78,6 +79,10 @@ extern "C" pid_t getcid() {
   return syscallStub(SyscallNum::getcid);
 }
 
+extern "C" pid_t fork() {
+  return syscallStub(SyscallNum::fork);
+}
+
 extern "C" int usleep(useconds_t usecs) {
   return syscallStub(SyscallNum::getcid, usecs);
 }
@@ -93,6 +98,13 @@ extern "C" int munmap(void* addr, size_t len) {
   if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
 }
 
+extern "C" int clock_gettime(clockid_t clock_id, struct timespec* tp) {
+  mword ns = syscallStub(SyscallNum::_clock_gettime);
+  tp->tv_sec = ns / 1000000000;
+  tp->tv_nsec = ns % 1000000000;
+  return 0;
+}
+
 extern "C" int privilege(void* func, mword a1, mword a2, mword a3, mword a4) {
   return syscallStub(SyscallNum::privilege, (mword)func, a1, a2, a3, a4);
 }
@@ -65,63 +65,305 @@ extern "C" int semV(mword sid) {
   return syscallStub(SyscallNum::semV, sid);
 }
 
+extern "C" int futexWait(mword* addr, mword expected, mword timeout) {
+  return syscallStub(SyscallNum::futexWait, mword(addr), expected, timeout);
+}
+
+extern "C" int futexWake(mword* addr, mword n) {
+  return syscallStub(SyscallNum::futexWake, mword(addr), n);
+}
+
+extern "C" int futexRequeue(mword* addr, mword n, mword* addr2, mword m, mword expected) {
+  return syscallStub(SyscallNum::futexRequeue, mword(addr), n, mword(addr2), m, expected);
+}
+
+static const int mutexSpin = 100;           // pause loops before blocking
+static const mword forever = ~mword(0);
+
+static mword nanos() {
+  return syscallStub(SyscallNum::_clock_gettime);
+}
+
+static mword deadline(const struct timespec* t) {
+  return mword(t->tv_sec) * 1000000000 + t->tv_nsec;
+}
+
+static mword remaining(mword deadline) {
+  if (deadline == forever) return forever;
+  mword now = nanos();
+  return deadline > now ? deadline - now : 0;
+}
+
+static int timedOut() {
+  *__errno() = ETIMEDOUT;
+  return -1;
+}
+
+// contended: mark state 2, then block until unlocker finds state 2
+static bool mutexLockContended(pthread_mutex_t* m, mword c, mword deadline = forever) {
+  for (int i = 0; i < mutexSpin && c == 1; i += 1) {
+    asm volatile("pause");
+    c = __atomic_load_n(&m->state, __ATOMIC_RELAXED);
+    if (c == 0) {
+      if (__atomic_compare_exchange_n(&m->state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return true;
+    }
+  }
+  if (c != 2) c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  while (c != 0) {
+    if (futexWait(&m->state, 2, remaining(deadline)) == -ETIMEDOUT) return false;
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+  return true;
+}
+
+// after condvar wakeup: other waiters might be requeued -> always mark 2
+static void mutexRelock(pthread_mutex_t* m) {
+  if (__atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE) != 0) mutexLockContended(m, 2);
+}
+
+// 'seq' sampled under mutex: a signal after unlock changes it -> no lost wakeup
+static int condWait(pthread_cond_t* c, pthread_mutex_t* m, mword deadline) {
+  mword seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&c->mutex, m, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&c->waiters, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(m);
+  int r = futexWait(&c->seq, seq, remaining(deadline));
+  __atomic_fetch_sub(&c->waiters, 1, __ATOMIC_RELAXED);
+  mutexRelock(m);
+  // timed out on the mutex after requeue: signalled before the deadline
+  if (r == -ETIMEDOUT && __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) == seq) return timedOut();
+  return 0;
+}
+
+// wake one waiter, move the others onto the mutex: each wakes the next when
+// unlocking (state 2), instead of all contending for the mutex at once
 extern "C" int pthread_cond_broadcast(pthread_cond_t* c) {
-  while (!c->ben.empty()) c->ben.V();
+  mword seq = __atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+  if (!__atomic_load_n(&c->waiters, __ATOMIC_RELAXED)) return 0;
+  pthread_mutex_t* m = __atomic_load_n(&c->mutex, __ATOMIC_RELAXED);
+  if (!m || futexRequeue(&c->seq, 1, &m->state, forever, seq) < 0) futexWake(&c->seq, forever);
   return 0;
 }
 
 extern "C" int pthread_cond_destroy(pthread_cond_t* c) {
-  c->ben.destroy();
   return 0;
 }
 
 extern "C" int pthread_cond_init(pthread_cond_t*restrict c, const pthread_condattr_t*restrict) {
-  c->ben.init(0);
+  c->seq = 0;
+  c->waiters = 0;
+  c->mutex = nullptr;
   return 0;
 }
 
 extern "C" int pthread_cond_signal(pthread_cond_t* c) {
-  if (!c->ben.empty()) c->ben.V();
+  __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+  if (__atomic_load_n(&c->waiters, __ATOMIC_RELAXED)) futexWake(&c->seq, 1);
   return 0;
 }
 
-//extern "C" int pthread_cond_timedwait(pthread_cond_t*restrict c, pthread_mutex_t*restrict m, const struct timespec*restrict t) {
-//  *__errno() = ENOTSUP;
-//  return -1;
-//}
+extern "C" int pthread_cond_timedwait(pthread_cond_t*restrict c, pthread_mutex_t*restrict m, const struct timespec*restrict t) {
+  return condWait(c, m, deadline(t));
+}
 
 extern "C" int pthread_cond_wait(pthread_cond_t*restrict c, pthread_mutex_t*restrict m) {
-  c->ben.P();
-  return 0;
+  return condWait(c, m, forever);
 }
 
 extern "C" int pthread_mutex_destroy(pthread_mutex_t* m) {
-  m->ben.destroy();
   return 0;
 }
 
 extern "C" int pthread_mutex_init(pthread_mutex_t*restrict m, const pthread_mutexattr_t*restrict a) {
-  m->ben.init(1);
+  m->state = 0;
   return 0;
 }
 
 extern "C" int pthread_mutex_lock(pthread_mutex_t* m) {
-  m->ben.P();
+  mword c = 0;
+  if (__atomic_compare_exchange_n(&m->state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return 0;
+  mutexLockContended(m, c);
   return 0;
 }
 
-//extern "C" int pthread_mutex_timedlock(pthread_mutex_t*restrict m, const struct timespec*restrict t) {
-//  *__errno() = ENOTSUP;
-//  return -1;
-//}
+extern "C" int pthread_mutex_timedlock(pthread_mutex_t*restrict m, const struct timespec*restrict t) {
+  mword c = 0;
+  if (__atomic_compare_exchange_n(&m->state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return 0;
+  return mutexLockContended(m, c, deadline(t)) ? 0 : timedOut();
+}
 
 extern "C" int pthread_mutex_trylock(pthread_mutex_t* m) {
-  if (m->ben.tryP()) return 0;
+  mword c = 0;
+  if (__atomic_compare_exchange_n(&m->state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return 0;
   *__errno() = EBUSY;
   return -1;
 }
 
 extern "C" int pthread_mutex_unlock(pthread_mutex_t* m) {
-  m->ben.V();
+  if (__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1) {
+    __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+    futexWake(&m->state, 1);
+  }
+  return 0;
+}
+
+// rwlock: readers enter with a single CAS, unless a writer holds or waits
+// for the lock (writer preference: recursive read locks may deadlock)
+static const mword rwWriter = mword(1) << 63;
+
+static bool rwTryRead(pthread_rwlock_t* rw) {
+  mword s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+  while (!(s & rwWriter) && !__atomic_load_n(&rw->writers, __ATOMIC_RELAXED)) {
+    if (__atomic_compare_exchange_n(&rw->state, &s, s + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return true;
+  }
+  return false;
+}
+
+static bool rwTryWrite(pthread_rwlock_t* rw) {
+  mword s = 0;
+  return __atomic_compare_exchange_n(&rw->state, &s, rwWriter, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// unlock side: change 'state', bump 'seq', then check 'waiters'
+static void rwWake(pthread_rwlock_t* rw) {
+  __atomic_fetch_add(&rw->seq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&rw->waiters, __ATOMIC_SEQ_CST)) futexWake(&rw->seq, forever);
+}
+
+// sleep until the next waking unlock: announced in 'waiters' and 'seq'
+// sampled before 'state', so any unlock after the sample changes 'seq'
+static int rwBlock(pthread_rwlock_t* rw, bool reader, mword deadline) {
+  __atomic_fetch_add(&rw->waiters, 1, __ATOMIC_SEQ_CST);
+  mword seq = __atomic_load_n(&rw->seq, __ATOMIC_SEQ_CST);
+  mword s = __atomic_load_n(&rw->state, __ATOMIC_SEQ_CST);
+  int r = 0;
+  if (reader ? (s & rwWriter) || __atomic_load_n(&rw->writers, __ATOMIC_SEQ_CST) : s != 0) {
+    r = futexWait(&rw->seq, seq, remaining(deadline));
+  }
+  __atomic_fetch_sub(&rw->waiters, 1, __ATOMIC_RELAXED);
+  return r;
+}
+
+static int rwRead(pthread_rwlock_t* rw, mword deadline) {
+  for (int i = 0; !rwTryRead(rw); i += 1) {
+    if (i < mutexSpin) asm volatile("pause");
+    else if (rwBlock(rw, true, deadline) == -ETIMEDOUT) return timedOut();
+  }
+  return 0;
+}
+
+static int rwWrite(pthread_rwlock_t* rw, mword deadline) {
+  if (rwTryWrite(rw)) return 0;
+  __atomic_fetch_add(&rw->writers, 1, __ATOMIC_SEQ_CST);
+  for (int i = 0; !rwTryWrite(rw); i += 1) {
+    if (i < mutexSpin) {
+      asm volatile("pause");
+    } else if (rwBlock(rw, false, deadline) == -ETIMEDOUT) {
+      // readers might be held off by this writer alone
+      if (__atomic_sub_fetch(&rw->writers, 1, __ATOMIC_SEQ_CST) == 0) rwWake(rw);
+      return timedOut();
+    }
+  }
+  __atomic_fetch_sub(&rw->writers, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+extern "C" int pthread_rwlock_destroy(pthread_rwlock_t* rw) {
+  return 0;
+}
+
+extern "C" int pthread_rwlock_init(pthread_rwlock_t*restrict rw, const pthread_rwlockattr_t*restrict a) {
+  rw->state = 0;
+  rw->seq = 0;
+  rw->waiters = 0;
+  rw->writers = 0;
+  return 0;
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t* rw) {
+  return rwRead(rw, forever);
+}
+
+extern "C" int pthread_rwlock_timedrdlock(pthread_rwlock_t*restrict rw, const struct timespec*restrict t) {
+  return rwRead(rw, deadline(t));
+}
+
+extern "C" int pthread_rwlock_timedwrlock(pthread_rwlock_t*restrict rw, const struct timespec*restrict t) {
+  return rwWrite(rw, deadline(t));
+}
+
+extern "C" int pthread_rwlock_tryrdlock(pthread_rwlock_t* rw) {
+  if (rwTryRead(rw)) return 0;
+  *__errno() = EBUSY;
+  return -1;
+}
+
+extern "C" int pthread_rwlock_trywrlock(pthread_rwlock_t* rw) {
+  if (rwTryWrite(rw)) return 0;
+  *__errno() = EBUSY;
+  return -1;
+}
+
+// wake all: readers proceed together, writers retry
+extern "C" int pthread_rwlock_unlock(pthread_rwlock_t* rw) {
+  if (__atomic_load_n(&rw->state, __ATOMIC_RELAXED) & rwWriter) {
+    __atomic_store_n(&rw->state, 0, __ATOMIC_SEQ_CST);
+  } else if (__atomic_sub_fetch(&rw->state, 1, __ATOMIC_SEQ_CST) != 0) {
+    return 0;
+  }
+  rwWake(rw);
+  return 0;
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t* rw) {
+  return rwWrite(rw, forever);
+}
+
+extern "C" int pthread_rwlockattr_destroy(pthread_rwlockattr_t* a) {
+  return 0;
+}
+
+extern "C" int pthread_rwlockattr_init(pthread_rwlockattr_t* a) {
+  *a = 0;
+  return 0;
+}
+
+// barrier: 'seq' advances per round; 'arrived' reset before release
+extern "C" int pthread_barrier_destroy(pthread_barrier_t* b) {
+  return 0;
+}
+
+extern "C" int pthread_barrier_init(pthread_barrier_t*restrict b, const pthread_barrierattr_t*restrict a, unsigned count) {
+  if (count == 0) {
+    *__errno() = EINVAL;
+    return -1;
+  }
+  b->count = count;
+  b->arrived = 0;
+  b->seq = 0;
+  return 0;
+}
+
+extern "C" int pthread_barrier_wait(pthread_barrier_t* b) {
+  mword seq = __atomic_load_n(&b->seq, __ATOMIC_ACQUIRE);
+  if (__atomic_add_fetch(&b->arrived, 1, __ATOMIC_ACQ_REL) == b->count) {
+    __atomic_store_n(&b->arrived, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->seq, seq + 1, __ATOMIC_RELEASE);
+    futexWake(&b->seq, forever);
+    return PTHREAD_BARRIER_SERIAL_THREAD;
+  }
+  for (int i = 0; __atomic_load_n(&b->seq, __ATOMIC_ACQUIRE) == seq; i += 1) {
+    if (i < mutexSpin) asm volatile("pause");
+    else futexWait(&b->seq, seq, forever);
+  }
+  return 0;
+}
+
+extern "C" int pthread_barrierattr_destroy(pthread_barrierattr_t* a) {
+  return 0;
+}
+
+extern "C" int pthread_barrierattr_init(pthread_barrierattr_t* a) {
+  *a = 0;
   return 0;
 }
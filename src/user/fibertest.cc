@@ -0,0 +1,168 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+#include "fiber.h"
+
+#include <cstdio>
+
+// user-level fibers vs. kernel threads: creation, yield, and semaphore
+// ping-pong latency, plus a blocking call that must not stall its VP
+static const int vps = 2;
+static const int creates = 256;
+static const int yields = 10000;
+static const int rounds = 10000;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
+
+static void* empty(void*) {
+  return nullptr;
+}
+
+static Benaphore kping, kpong;
+
+static void* kernelPong(void*) {
+  for (int i = 0; i < rounds; i += 1) {
+    kping.P();
+    kpong.V();
+  }
+  return nullptr;
+}
+
+static void* kernelYield(void*) {
+  for (int i = 0; i < yields; i += 1) syscallStub(SyscallNum::usleep, 0);
+  return nullptr;
+}
+
+static void kernelThreads() {
+  pthread_t t[creates];
+  unsigned long start = rdtsc();
+  for (int i = 0; i < creates; i += 1) pthread_create(&t[i], nullptr, empty, nullptr);
+  for (int i = 0; i < creates; i += 1) pthread_join(t[i], nullptr);
+  printf("fibertest: kernel thread create/join %lu cycles\n", (rdtsc() - start) / creates);
+
+  start = rdtsc();
+  pthread_create(&t[0], nullptr, kernelYield, nullptr);
+  pthread_create(&t[1], nullptr, kernelYield, nullptr);
+  pthread_join(t[0], nullptr);
+  pthread_join(t[1], nullptr);
+  printf("fibertest: kernel thread yield (usleep 0) %lu cycles\n", (rdtsc() - start) / (2 * yields));
+
+  kping.init(0);
+  kpong.init(0);
+  start = rdtsc();
+  pthread_create(&t[0], nullptr, kernelPong, nullptr);
+  for (int i = 0; i < rounds; i += 1) {
+    kping.V();
+    kpong.P();
+  }
+  pthread_join(t[0], nullptr);
+  printf("fibertest: kernel thread ping-pong %lu cycles\n", (rdtsc() - start) / rounds);
+  kping.destroy();
+  kpong.destroy();
+}
+
+static fiber_sem_t fping, fpong;
+static volatile bool sleeping;
+
+static void* fiberPong(void*) {
+  for (int i = 0; i < rounds; i += 1) {
+    fiber_sem_P(&fping);
+    fiber_sem_V(&fpong);
+  }
+  return nullptr;
+}
+
+static void* fiberYield(void*) {
+  for (int i = 0; i < yields; i += 1) fiber_yield();
+  return nullptr;
+}
+
+static void* fiberSleep(void*) {
+  sleeping = true;
+  fiber_usleep(100000);
+  sleeping = false;
+  return nullptr;
+}
+
+static volatile mword vpSeen;
+
+// spin between yields, so runnable siblings pile up and idle VPs steal them
+static void* fiberSpread(void*) {
+  for (int i = 0; i < 100; i += 1) {
+    __atomic_or_fetch(&vpSeen, mword(1) << fiber_vp(), __ATOMIC_RELAXED);
+    for (volatile int j = 0; j < 10000; j += 1);
+    fiber_yield();
+  }
+  return nullptr;
+}
+
+static void* fiberMain(void*) {
+  fiber_t f[creates];
+  unsigned long start = rdtsc();
+  for (int i = 0; i < creates; i += 1) fiber_create(&f[i], empty, nullptr);
+  for (int i = 0; i < creates; i += 1) fiber_join(f[i], nullptr);
+  printf("fibertest: fiber create/join %lu cycles\n", (rdtsc() - start) / creates);
+
+  start = rdtsc();
+  fiber_create(&f[0], fiberYield, nullptr);
+  fiber_create(&f[1], fiberYield, nullptr);
+  fiber_join(f[0], nullptr);
+  fiber_join(f[1], nullptr);
+  printf("fibertest: fiber yield %lu cycles\n", (rdtsc() - start) / (2 * yields));
+
+  fiber_sem_init(&fping, 0);
+  fiber_sem_init(&fpong, 0);
+  start = rdtsc();
+  fiber_create(&f[0], fiberPong, nullptr);
+  for (int i = 0; i < rounds; i += 1) {
+    fiber_sem_V(&fping);
+    fiber_sem_P(&fpong);
+  }
+  fiber_join(f[0], nullptr);
+  printf("fibertest: fiber ping-pong %lu cycles\n", (rdtsc() - start) / rounds);
+
+  // while one fiber sleeps in the kernel, the others keep running
+  fiber_create(&f[0], fiberSleep, nullptr);
+  while (!sleeping) fiber_yield();
+  int progress = 0;
+  while (sleeping) {
+    fiber_create(&f[1], empty, nullptr);
+    fiber_join(f[1], nullptr);
+    progress += 1;
+  }
+  fiber_join(f[0], nullptr);
+  printf("fibertest: %d fibers completed during blocking call\n", progress);
+
+  // fibers created on one VP must spread to the others
+  for (int i = 0; i < 4 * vps; i += 1) fiber_create(&f[i], fiberSpread, nullptr);
+  for (int i = 0; i < 4 * vps; i += 1) fiber_join(f[i], nullptr);
+  int spread = __builtin_popcountl(vpSeen);
+  printf("fibertest: fibers ran on %d of %d VPs%s\n", spread, vps, spread > 1 ? "" : " - FAILED");
+  return nullptr;
+}
+
+int main() {
+  kernelThreads();
+  fiber_run(vps, fiberMain, nullptr, nullptr);
+  printf("fibertest: done\n");
+  return 0;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+// copy-on-write fork and shared zero page: fork latency over a populated
+// heap, isolation of parent and child writes, and read-fault cost
+static const size_t heapSize = 64 << 20;
+static const size_t chunkSize = 1 << 20;   // below huge-page mapping size
+static const int chunks = 64;
+static const int forks = 16;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
+
+int main() {
+  volatile char* sparse[chunks];
+  for (int c = 0; c < chunks; c += 1) sparse[c] = (volatile char*)malloc(chunkSize);
+  unsigned long start = rdtsc();
+  unsigned long sum = 0;
+  for (int c = 0; c < chunks; c += 1) {
+    for (size_t i = 0; i < chunkSize; i += 4096) sum += sparse[c][i]; // zero page
+  }
+  printf("forktest: %lu cycles/4K read fault (%lu)\n", (rdtsc() - start) / (chunks * chunkSize / 4096), sum);
+
+  char* heap = (char*)malloc(heapSize);
+  memset(heap, 'p', heapSize);
+  unsigned long cycles = 0;
+  for (int i = 0; i < forks; i += 1) {
+    start = rdtsc();
+    pid_t pid = fork();
+    if (pid == 0) {
+      heap[i * 4096] = 'c';                // private copy
+      if (heap[(i + 2) * 4096] != 'p') printf("forktest child %d: bad data\n", i);
+      _exit(0);
+    }
+    cycles += rdtsc() - start;
+    heap[(i + 2) * 4096] = 'q';            // parent copy, child unaffected
+  }
+  usleep(100000);
+  for (int i = 0; i < forks; i += 1) {
+    if (heap[i * 4096] == 'c') printf("forktest: child write visible in parent\n");
+  }
+  printf("forktest: %lu cycles/fork with %luMB heap\n", cycles / forks, (unsigned long)(heapSize >> 20));
+  free(heap);
+  for (int c = 0; c < chunks; c += 1) free((void*)sparse[c]);
+  return 0;
+}
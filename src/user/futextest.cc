@@ -0,0 +1,105 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+
+#include <cstdio>
+
+// lock contention: futex-based pthread mutex vs. kernel-semaphore Benaphore,
+// plus condition-variable handoff between two threads
+static const int threads = 4;
+static const int iterations = 100000;
+static const int handoffs = 10000;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
+
+static pthread_mutex_t mutex;
+static Benaphore benaphore;
+static volatile long counter;
+
+static void* mutexLoop(void*) {
+  for (int i = 0; i < iterations; i += 1) {
+    pthread_mutex_lock(&mutex);
+    counter += 1;
+    pthread_mutex_unlock(&mutex);
+  }
+  return nullptr;
+}
+
+static void* benaphoreLoop(void*) {
+  for (int i = 0; i < iterations; i += 1) {
+    benaphore.P();
+    counter += 1;
+    benaphore.V();
+  }
+  return nullptr;
+}
+
+static void contention(const char* name, void* (*loop)(void*)) {
+  pthread_t t[threads];
+  counter = 0;
+  unsigned long start = rdtsc();
+  for (int i = 0; i < threads; i += 1) pthread_create(&t[i], nullptr, loop, nullptr);
+  for (int i = 0; i < threads; i += 1) pthread_join(t[i], nullptr);
+  unsigned long cycles = rdtsc() - start;
+  printf("futextest: %s %lu cycles/op, %d threads (%s)\n", name, cycles / (threads * iterations),
+    threads, counter == long(threads) * iterations ? "ok" : "LOST UPDATES");
+}
+
+static pthread_cond_t cond;
+static volatile int turn;
+
+static void* condPartner(void*) {
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < handoffs; i += 1) {
+    while (turn != 1) pthread_cond_wait(&cond, &mutex);
+    turn = 0;
+    pthread_cond_signal(&cond);
+  }
+  pthread_mutex_unlock(&mutex);
+  return nullptr;
+}
+
+int main() {
+  pthread_mutex_init(&mutex, nullptr);
+  benaphore.init(1);
+  contention("pthread_mutex", mutexLoop);
+  contention("benaphore", benaphoreLoop);
+  benaphore.destroy();
+
+  pthread_cond_init(&cond, nullptr);
+  turn = 0;
+  pthread_t t;
+  pthread_create(&t, nullptr, condPartner, nullptr);
+  unsigned long start = rdtsc();
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < handoffs; i += 1) {
+    turn = 1;
+    pthread_cond_signal(&cond);
+    while (turn != 0) pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+  pthread_join(t, nullptr);
+  printf("futextest: condvar handoff %lu cycles\n", (rdtsc() - start) / handoffs);
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+  return 0;
+}
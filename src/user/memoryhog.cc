@@ -18,36 +18,45 @@
 #include "pthread.h"
 
 #include <cstdio>
-#include <cstring>
+
+// page-fault storm: threads repeatedly map, touch and release 1MB regions
+static const int threads = 16;
+static const int rounds = 200;
+static const size_t region = 1 << 20;
+static const size_t pagesize = 4096;
 
 static pthread_mutex_t iolock;
-static pthread_mutex_t mlock;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
 
 static void* task(void* x) {
-  while (1) {
-    pthread_mutex_lock(&mlock);
-    void* p = malloc(1023*1023);
-    pthread_mutex_unlock(&mlock);
-    pthread_mutex_lock(&iolock);
-    printf("%p\n",p);
-    pthread_mutex_unlock(&iolock);
-    memset(p, 0, 1023*1023);
+  unsigned long start = rdtsc();
+  int r = 0;
+  for (; r < rounds; r += 1) {
+    // map directly: malloc is not thread-safe
+    char* p = (char*)mmap(nullptr, region, 0, 0, -1, 0);
+    if (p == MAP_FAILED) break;
+    for (size_t i = 0; i < region; i += pagesize) p[i] = 1; // fault
+    munmap(p, region);
   }
+  unsigned long cycles = rdtsc() - start;
+  unsigned long faults = r * (region / pagesize);       // completed rounds only
+  pthread_mutex_lock(&iolock);
+  if (r < rounds) printf("memoryhog %ld: mmap failed after %d rounds\n", (long)x, r);
+  printf("memoryhog %ld (core %d): %lu faults, %lu cycles/fault\n", (long)x, getcid(), faults, faults ? cycles / faults : 0);
+  pthread_mutex_unlock(&iolock);
+  return nullptr;
 }
 
 int main() {
   pthread_mutex_init( &iolock, nullptr );
-  pthread_mutex_init( &mlock, nullptr );
-  pthread_t t;
-  pthread_create(&t, nullptr, task, nullptr);
-  while (1) {
-    pthread_mutex_lock(&mlock);
-    void* p = malloc(1023*1023);
-    pthread_mutex_unlock(&mlock);
-    pthread_mutex_lock(&iolock);
-    printf("%p\n",p);
-    pthread_mutex_unlock(&iolock);
-    memset(p, 0, 1023*1023);
-  }
+  pthread_t t[threads];
+  for (long i = 1; i < threads; i += 1) pthread_create(&t[i], nullptr, task, (void*)i);
+  task((void*)0);
+  for (int i = 1; i < threads; i += 1) pthread_join(t[i], nullptr);
   return 0;
 }
@@ -0,0 +1,201 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+
+#include <cstdio>
+#include <ctime>
+
+// condition variables, rwlocks, and barriers: correctness checks followed
+// by throughput (broadcast wakeup, read-mostly lookups, barrier rounds)
+static const int threads = 4;
+static const int broadcasts = 1000;
+static const int lookups = 100000;
+static const int writeRatio = 20;           // one update per 20 lookups
+static const int rounds = 10000;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("synctest: FAILED %s\n", what);
+    failures += 1;
+  }
+}
+
+/******* condition variables *******/
+
+static pthread_mutex_t mutex;
+static pthread_cond_t cond;
+static volatile int generation;
+static volatile int awake;
+
+static void* condWaiter(void*) {
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < broadcasts; i += 1) {
+    while (generation <= i) pthread_cond_wait(&cond, &mutex);
+    awake += 1;
+    pthread_cond_broadcast(&cond);          // tell broadcaster
+  }
+  pthread_mutex_unlock(&mutex);
+  return nullptr;
+}
+
+static void condTest() {
+  pthread_mutex_init(&mutex, nullptr);
+  pthread_cond_init(&cond, nullptr);
+
+  // timedwait: nobody signals -> must time out with mutex held
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_nsec += 10000000;
+  if (ts.tv_nsec >= 1000000000) { ts.tv_sec += 1; ts.tv_nsec -= 1000000000; }
+  pthread_mutex_lock(&mutex);
+  int r = pthread_cond_timedwait(&cond, &mutex, &ts);
+  check(r == -1 && errno == ETIMEDOUT, "cond_timedwait timeout");
+  check(pthread_mutex_trylock(&mutex) == -1, "cond_timedwait reacquires mutex");
+  pthread_mutex_unlock(&mutex);
+
+  // broadcast: every round wakes all waiters exactly once
+  pthread_t t[threads];
+  generation = 0;
+  awake = 0;
+  for (int i = 0; i < threads; i += 1) pthread_create(&t[i], nullptr, condWaiter, nullptr);
+  unsigned long start = rdtsc();
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < broadcasts; i += 1) {
+    while (awake < threads * i) pthread_cond_wait(&cond, &mutex);
+    generation += 1;
+    pthread_cond_broadcast(&cond);
+  }
+  pthread_mutex_unlock(&mutex);
+  for (int i = 0; i < threads; i += 1) pthread_join(t[i], nullptr);
+  printf("synctest: cond broadcast to %d waiters %lu cycles\n", threads, (rdtsc() - start) / broadcasts);
+  check(awake == threads * broadcasts, "cond_broadcast wakes all");
+  pthread_cond_destroy(&cond);
+}
+
+/******* rwlocks *******/
+
+static pthread_rwlock_t rwlock;
+static volatile long table[64];             // invariant: all entries equal
+static volatile int writers;
+
+static bool consistent() {
+  for (int i = 1; i < 64; i += 1) if (table[i] != table[0]) return false;
+  return true;
+}
+
+static void update() {
+  check(++writers == 1, "rwlock writer exclusion");
+  for (int i = 0; i < 64; i += 1) table[i] += 1;
+  writers -= 1;
+}
+
+static void* rwLoop(void*) {
+  for (int i = 0; i < lookups; i += 1) {
+    if (i % writeRatio == 0) {
+      pthread_rwlock_wrlock(&rwlock);
+      update();
+      pthread_rwlock_unlock(&rwlock);
+    } else {
+      pthread_rwlock_rdlock(&rwlock);
+      check(writers == 0 && consistent(), "rwlock reader consistency");
+      pthread_rwlock_unlock(&rwlock);
+    }
+  }
+  return nullptr;
+}
+
+static void* mutexLoop(void*) {
+  for (int i = 0; i < lookups; i += 1) {
+    pthread_mutex_lock(&mutex);
+    if (i % writeRatio == 0) update();
+    else check(consistent(), "mutex consistency");
+    pthread_mutex_unlock(&mutex);
+  }
+  return nullptr;
+}
+
+static void rwTest() {
+  pthread_rwlock_init(&rwlock, nullptr);
+  pthread_rwlock_rdlock(&rwlock);
+  check(pthread_rwlock_tryrdlock(&rwlock) == 0, "rwlock shared read");
+  check(pthread_rwlock_trywrlock(&rwlock) == -1, "rwlock write excluded by read");
+  pthread_rwlock_unlock(&rwlock);
+  pthread_rwlock_unlock(&rwlock);
+  check(pthread_rwlock_trywrlock(&rwlock) == 0, "rwlock write after release");
+  check(pthread_rwlock_tryrdlock(&rwlock) == -1, "rwlock read excluded by write");
+  pthread_rwlock_unlock(&rwlock);
+
+  pthread_t t[threads];
+  void* (*loops[2])(void*) = { rwLoop, mutexLoop };
+  const char* names[2] = { "rwlock", "mutex" };
+  for (int l = 0; l < 2; l += 1) {
+    unsigned long start = rdtsc();
+    for (int i = 0; i < threads; i += 1) pthread_create(&t[i], nullptr, loops[l], nullptr);
+    for (int i = 0; i < threads; i += 1) pthread_join(t[i], nullptr);
+    printf("synctest: %s read-mostly %lu cycles/op, %d threads\n", names[l],
+      (rdtsc() - start) / (threads * lookups), threads);
+  }
+  check(table[0] == 2L * threads * (lookups / writeRatio), "rwlock update count");
+  pthread_rwlock_destroy(&rwlock);
+  pthread_mutex_destroy(&mutex);
+}
+
+/******* barriers *******/
+
+static pthread_barrier_t barrier;
+static volatile int phase[threads];
+static volatile int serial;
+
+static void* barrierLoop(void* arg) {
+  long id = (long)arg;
+  for (int r = 0; r < rounds; r += 1) {
+    phase[id] = r;
+    if (pthread_barrier_wait(&barrier) == PTHREAD_BARRIER_SERIAL_THREAD) __atomic_fetch_add(&serial, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < threads; i += 1) check(phase[i] >= r, "barrier phase");
+    pthread_barrier_wait(&barrier);
+  }
+  return nullptr;
+}
+
+static void barrierTest() {
+  pthread_barrier_init(&barrier, nullptr, threads);
+  serial = 0;
+  pthread_t t[threads];
+  unsigned long start = rdtsc();
+  for (long i = 0; i < threads; i += 1) pthread_create(&t[i], nullptr, barrierLoop, (void*)i);
+  for (int i = 0; i < threads; i += 1) pthread_join(t[i], nullptr);
+  printf("synctest: barrier %lu cycles/round, %d threads\n", (rdtsc() - start) / (2 * rounds), threads);
+  check(serial == rounds, "barrier serial thread");
+  pthread_barrier_destroy(&barrier);
+}
+
+int main() {
+  condTest();
+  rwTest();
+  barrierTest();
+  printf("synctest: %d failures\n", failures);
+  return 0;
+}
@@ -0,0 +1,57 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// TLB-heavy benchmark: random accesses over large arrays; compare kernels
+// built with and without TESTING_NEVER_HUGEPAGES
+static const size_t minSize = 4 << 20;
+static const size_t maxSize = 256 << 20;
+static const unsigned long accesses = 1 << 22;
+
+static inline unsigned long rdtsc() {
+  unsigned int lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (unsigned long)hi << 32 | lo;
+}
+
+int main() {
+  for (size_t size = minSize; size <= maxSize; size *= 4) {
+    volatile char* p = (volatile char*)malloc(size);
+    if (!p) {
+      printf("tlbtest: cannot allocate %lu bytes\n", (unsigned long)size);
+      return 1;
+    }
+    unsigned long start = rdtsc();
+    for (size_t i = 0; i < size; i += 4096) p[i] = 1;      // fault in
+    unsigned long faults = rdtsc() - start;
+    unsigned long x = 12345;
+    unsigned long sum = 0;
+    start = rdtsc();
+    for (unsigned long i = 0; i < accesses; i += 1) {
+      x = x * 6364136223846793005UL + 1442695040888963407UL;  // LCG
+      sum += p[(x >> 16) % size];
+    }
+    unsigned long cycles = rdtsc() - start;
+    printf("tlbtest %luMB: %lu cycles/access, %lu cycles/4K-fault (%lu)\n",
+      (unsigned long)(size >> 20), cycles / accesses, faults / (size / 4096), sum);
+    free((void*)p);
+  }
+  return 0;
+}
@@ -36,11 +36,14 @@ public:
   virtual off_t lseek(off_t o, int whence) { return -EBADF; }
 };
 
+class ElfImage;
+
 struct RamFile {
   vaddr vma;
   paddr pma;
   size_t size;
-  RamFile(vaddr v, paddr p, size_t s) : vma(v), pma(p), size(s) {}
+  ElfImage* image;             // parsed on first exec, cf. ElfImage::get
+  RamFile(vaddr v, paddr p, size_t s) : vma(v), pma(p), size(s), image(nullptr) {}
 };
 
 extern map<string,RamFile> kernelFS;